@@ -0,0 +1,706 @@
+/*
+    Bit-parallel edit distance kernels for the Damerau–Levenshtein UDFs.
+
+    Instead of filling in the DP matrix one cell at a time, these kernels keep a
+    whole column of the matrix in the bits of a machine word. Cell values are never
+    stored; only the vertical differences between neighbouring cells are, as two bit
+    vectors VP ("+1") and VN ("-1"). One step of the outer loop then costs a handful
+    of word operations regardless of how long the pattern is, as long as it fits in
+    a word.
+
+    The pattern is described by its match masks: `peq[c]` has bit `i` set exactly
+    when `pattern[i] == c`. Computing them is the only part that depends on the
+    pattern, so callers that compare many strings against the same pattern (see
+    `DAMLEVCONST()`) only need to build them once.
+
+    The optimal string alignment (restricted Damerau–Levenshtein) kernel is the one
+    from
+
+        H. Hyyrö, "A Bit-Vector Algorithm for Computing Levenshtein and Damerau Edit
+        Distances", Nordic Journal of Computing 10 (2003).
+
+    Released under the MIT license. See LICENSE.txt.
+*/
+
+#pragma once
+
+#include <algorithm>
+#include <bitset>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <string_view>
+
+// The number of pattern characters that fit in one word.
+constexpr size_t BITPAR_WORD_BITS = 64;
+
+// Size of a match mask table: one entry per possible byte value.
+constexpr size_t BITPAR_ALPHABET_SIZE = 256;
+
+/*
+    How the OSA kernels below turn a character of the text into an index into `peq`.
+    The default is the byte itself, with a table of BITPAR_ALPHABET_SIZE masks. A
+    small alphabet can map its symbols to a few codes instead, which shrinks the table
+    to a few masks (see dna.h).
+*/
+struct BitparBytes {
+    static unsigned char code(char c) { return (unsigned char)c; }
+};
+
+// Fills `peq`, which must have room for `BITPAR_ALPHABET_SIZE` words, with the match
+// masks of `pattern`. Only the first `BITPAR_WORD_BITS` characters of `pattern` are
+// used.
+inline void bitpar_build_peq(std::string_view pattern, uint64_t *peq) {
+    std::fill(peq, peq + BITPAR_ALPHABET_SIZE, 0ull);
+    const size_t m = std::min(pattern.length(), BITPAR_WORD_BITS);
+    for (size_t i = 0; i < m; ++i) {
+        peq[(unsigned char)pattern[i]] |= 1ull << i;
+    }
+}
+
+/*
+    Computes the optimal string alignment distance between `text` and the pattern
+    whose match masks are in `peq`.
+
+    The pattern is taken to be the `m` characters starting at position `shift` of the
+    string `peq` was built from, which lets callers trim a common prefix and suffix
+    without rebuilding the masks. Bits above `m` are never looked at by the result:
+    every operation below only carries information from lower bits to higher ones.
+
+    If the distance is greater than `max`, the function may stop early and return any
+    value greater than `max`.
+*/
+template <typename Alphabet = BitparBytes>
+long long bitpar_osa_word(const uint64_t *peq, size_t shift, size_t m,
+                          std::string_view text, long long max) {
+    const size_t n = text.length();
+    if (0 == m) {
+        return (long long)n;
+    }
+    if (0 == n) {
+        return (long long)m;
+    }
+
+    const uint64_t last = 1ull << (m - 1);
+    uint64_t VP = ~0ull;
+    uint64_t VN = 0;
+    uint64_t D0 = 0;
+    uint64_t PM_prev = 0;
+    long long distance = (long long)m;
+
+    for (size_t j = 0; j < n; ++j) {
+        const uint64_t PM = peq[Alphabet::code(text[j])] >> shift;
+
+        // Transpositions: pattern[i-1] == text[j], pattern[i] == text[j-1], and the
+        // diagonal did not already stay flat at (i-1, j-1).
+        const uint64_t TR = (((~D0) & PM) << 1) & PM_prev;
+        D0 = (((PM & VP) + VP) ^ VP) | PM | VN | TR;
+
+        uint64_t HP = VN | ~(D0 | VP);
+        uint64_t HN = D0 & VP;
+        distance += (HP & last) ? 1 : 0;
+        distance -= (HN & last) ? 1 : 0;
+
+        // Each remaining text character can lower the distance by at most one.
+        if (distance - (long long)(n - j - 1) > max) {
+            return max + 1;
+        }
+
+        HP = (HP << 1) | 1;
+        HN = HN << 1;
+        VP = HN | ~(D0 | HP);
+        VN = HP & D0;
+        PM_prev = PM;
+    }
+
+    return distance;
+}
+
+/*
+    Multi-word version of the kernel above, for patterns longer than one word.
+
+    The pattern is split into blocks of `BITPAR_WORD_BITS` rows, and `peq` holds
+    `words` masks per character, laid out as `peq[c * words + w]`. A block only has
+    to be evaluated while it can still hold a cell on an alignment of cost at most
+    `max`, which keeps the cost of a text character at roughly ceil(max/64) words:
+
+    * Cells further than `max` from the diagonal the alignment has to end on can never
+      be on such an alignment (Ukkonen's band), so blocks are only switched on once
+      the band reaches them and switched off once it has passed them.
+    * A block at the top of the band is also switched off once every one of its
+      cells is provably too expensive, which happens well before the band leaves it
+      when the text is far from the pattern.
+
+    Cells outside the evaluated blocks are treated as if reached by the most
+    expensive route, so they can only ever be overestimated. Every cell on an
+    optimal alignment of cost at most `max` is computed exactly, so the result is
+    exact whenever the distance is at most `max`.
+*/
+
+// The state of one block of the pattern at the current text position.
+struct BitparBlock {
+    uint64_t VP;
+    uint64_t VN;
+    uint64_t D0;
+    // The match mask of the previous text character, needed for transpositions.
+    uint64_t PM;
+    // The value of the cell in the block's last row.
+    long long score;
+};
+
+// Fills `peq`, which must have room for `BITPAR_ALPHABET_SIZE * words` words, with the
+// match masks of the first `64 * words` characters of `pattern`.
+inline void bitpar_build_peq_blocks(std::string_view pattern, uint64_t *peq, size_t words) {
+    std::fill(peq, peq + BITPAR_ALPHABET_SIZE * words, 0ull);
+    const size_t m = std::min(pattern.length(), BITPAR_WORD_BITS * words);
+    for (size_t i = 0; i < m; ++i) {
+        peq[(unsigned char)pattern[i] * words + i / BITPAR_WORD_BITS] |= 1ull << (i % BITPAR_WORD_BITS);
+    }
+}
+
+// Word `w` of the masks of `c` for the pattern starting `shift` characters in.
+inline uint64_t bitpar_peq_word(const uint64_t *peq, size_t words, unsigned char c,
+                                size_t shift, size_t w) {
+    const uint64_t *masks = peq + c * words;
+    const size_t bit = shift + w * BITPAR_WORD_BITS;
+    const size_t index = bit / BITPAR_WORD_BITS;
+    const size_t offset = bit % BITPAR_WORD_BITS;
+    uint64_t word = index < words ? masks[index] >> offset : 0;
+    if (0 != offset && index + 1 < words) {
+        word |= masks[index + 1] << (BITPAR_WORD_BITS - offset);
+    }
+    return word;
+}
+
+/*
+    Computes the optimal string alignment distance between `text` and the `m`
+    characters starting at position `shift` of the pattern whose masks are in `peq`.
+    `blocks` must have room for ceil(m/64) entries.
+
+    If the distance is greater than `max`, returns some value greater than `max`.
+*/
+template <typename Alphabet = BitparBytes>
+long long bitpar_osa_blocks(const uint64_t *peq, size_t words, size_t shift, size_t m,
+                            std::string_view text, long long max, BitparBlock *blocks) {
+    const long long n = (long long)text.length();
+    const long long rows = (long long)m;
+    if (0 == rows) {
+        return n;
+    }
+    if (0 == n) {
+        return rows;
+    }
+    // Every alignment needs at least this many insertions or deletions.
+    if (std::abs(rows - n) > max) {
+        return max + 1;
+    }
+    const long long k = std::min(max, std::max(rows, n));
+    if (0 == k) {
+        // Only an exact match will do, and then every character is on the diagonal.
+        for (long long j = 0; j < n; ++j) {
+            const uint64_t PM = bitpar_peq_word(peq, words, Alphabet::code(text[j]), shift,
+                                                (size_t)j / BITPAR_WORD_BITS);
+            if (0 == (PM & (1ull << (j % BITPAR_WORD_BITS)))) {
+                return max + 1;
+            }
+        }
+        return 0;
+    }
+
+    // Cell (i, j) can only be on an alignment of cost at most k if lo <= i - j <= hi.
+    const long long lo = std::max(-k, rows - n - k);
+    const long long hi = std::min(k, rows - n + k);
+    const long long W = (long long)BITPAR_WORD_BITS;
+    const long long last_block = (rows - 1) / W;
+    const uint64_t last_bit = 1ull << ((rows - 1) % W);
+
+    // Lower bound on the cost of an alignment through block b's cells in column j,
+    // from its last-row score and the fact that neighbouring cells differ by at most 1.
+    auto block_bound = [&](long long b, long long j) {
+        const long long top = b * W + 1;
+        const long long bottom = std::min(top + W - 1, rows);
+        const long long diagonal = rows - n + j;
+        return blocks[b].score - bottom + (top <= diagonal ? diagonal : 2 * top - diagonal);
+    };
+
+    long long first = 0;
+    long long last = -1;
+    bool hopeless = false;
+
+    for (long long j = 1; j <= n; ++j) {
+        const unsigned char c = Alphabet::code(text[j - 1]);
+        first = std::max(first, (std::max(1ll, j + lo) - 1) / W);
+        const long long band_last = (std::min(rows, j + hi) - 1) / W;
+
+        // Horizontal difference entering the top of the first block. Rows above the
+        // band are overestimated by letting them grow by one per column.
+        uint64_t HP_carry = 1;
+        uint64_t HN_carry = 0;
+        uint64_t TR_carry = 0;
+        // The value in the row above the current block. A block can only enter the
+        // band without one above it in the first column, where that row is row 0.
+        long long above_score = j;
+        // Row 0 is never stored, but alignments that start with insertions go through
+        // it, so it counts for as long as the first block is still evaluated.
+        long long bound = 0 == first ? j + std::abs(rows - n + j) : k + 1;
+
+        for (long long b = first; b <= band_last; ++b) {
+            BitparBlock &block = blocks[b];
+            const uint64_t PM = bitpar_peq_word(peq, words, c, shift, b);
+            const bool last_word = b == last_block;
+
+            if (b > last) {
+                // The block just entered the band. Start it off as if the previous
+                // column climbed by one per row from the cell above it.
+                block.VP = ~0ull;
+                block.VN = 0;
+                block.D0 = ~0ull;
+                block.PM = 0;
+                block.score = above_score - (long long)HP_carry + (long long)HN_carry
+                              + (std::min((b + 1) * W, rows) - b * W);
+                last = b;
+            }
+
+            const uint64_t VP = block.VP;
+            const uint64_t VN = block.VN;
+            const uint64_t TR = ((((~block.D0) & PM) << 1) | TR_carry) & block.PM;
+            TR_carry = ((~block.D0) & PM) >> (W - 1);
+
+            const uint64_t X = PM | HN_carry;
+            const uint64_t D0 = (((X & VP) + VP) ^ VP) | X | VN | TR;
+            uint64_t HP = VN | ~(D0 | VP);
+            uint64_t HN = D0 & VP;
+
+            const uint64_t HP_out = last_word ? ((HP & last_bit) ? 1 : 0) : HP >> (W - 1);
+            const uint64_t HN_out = last_word ? ((HN & last_bit) ? 1 : 0) : HN >> (W - 1);
+            HP = (HP << 1) | HP_carry;
+            HN = (HN << 1) | HN_carry;
+            HP_carry = HP_out;
+            HN_carry = HN_out;
+
+            block.VP = HN | ~(D0 | HP);
+            block.VN = HP & D0;
+            block.D0 = D0;
+            block.PM = PM;
+            block.score += (long long)HP_out - (long long)HN_out;
+            above_score = block.score;
+
+            bound = std::min(bound, block_bound(b, j));
+        }
+
+        // No alignment of cost at most k passes through this column. Transpositions
+        // can skip a column, so it takes two in a row to rule out every alignment.
+        if (bound > k) {
+            if (hopeless) {
+                return max + 1;
+            }
+            hopeless = true;
+        } else {
+            hopeless = false;
+        }
+
+        // Switch off leading blocks that have been too expensive for two columns. The
+        // bound changes by at most two per column, so one check covers both. Row 0 has
+        // to be out of the running before the first block is.
+        if (0 != first || j - 1 + std::abs(rows - n + j - 1) > k) {
+            while (first < band_last && block_bound(first, j) > k + 2) {
+                ++first;
+            }
+        }
+    }
+
+    const long long distance = blocks[last_block].score;
+    return distance > max ? max + 1 : distance;
+}
+
+/*
+    Scratch space for the bit-parallel kernels that lives for a whole statement, so
+    that rows never have to allocate.
+
+    `peq` is kept all-zero between rows: a row sets the masks of its pattern with
+    `bitpar_arena_set()` and clears exactly those entries again with
+    `bitpar_arena_clear()`, which costs O(m) instead of wiping all 256 entries. The
+    masks are laid out with a stride of `words`, the current capacity in blocks.
+*/
+struct BitparArena {
+    uint64_t *peq;
+    BitparBlock *blocks;
+    size_t words;
+};
+
+inline void bitpar_arena_free(BitparArena &arena) {
+    delete[] arena.peq;
+    delete[] arena.blocks;
+    arena.peq = nullptr;
+    arena.blocks = nullptr;
+    arena.words = 0;
+}
+
+// Makes room for patterns of `words` blocks. Returns false if memory ran out, in which
+// case the arena is left empty.
+inline bool bitpar_arena_reserve(BitparArena &arena, size_t words) {
+    if (words <= arena.words) {
+        return true;
+    }
+    // Grow geometrically so that a column of slowly increasing lengths does not
+    // reallocate on every row.
+    words = std::max(words, 2 * arena.words);
+    bitpar_arena_free(arena);
+    arena.peq = new(std::nothrow) uint64_t[BITPAR_ALPHABET_SIZE * words]();
+    arena.blocks = new(std::nothrow) BitparBlock[words];
+    if (nullptr == arena.peq || nullptr == arena.blocks) {
+        bitpar_arena_free(arena);
+        return false;
+    }
+    arena.words = words;
+    return true;
+}
+
+inline void bitpar_arena_set(BitparArena &arena, std::string_view pattern) {
+    for (size_t i = 0; i < pattern.length(); ++i) {
+        arena.peq[(unsigned char)pattern[i] * arena.words + i / BITPAR_WORD_BITS] |=
+                1ull << (i % BITPAR_WORD_BITS);
+    }
+}
+
+inline void bitpar_arena_clear(BitparArena &arena, std::string_view pattern) {
+    for (size_t i = 0; i < pattern.length(); ++i) {
+        arena.peq[(unsigned char)pattern[i] * arena.words + i / BITPAR_WORD_BITS] = 0;
+    }
+}
+
+/*
+    Plain Levenshtein distance (no transpositions) between `text` and a pattern of
+    `m <= 64` characters, using the algorithm of
+
+        G. Myers, "A Fast Bit-Vector Algorithm for Approximate String Matching Based
+        on Dynamic Programming", Journal of the ACM 46 (1999).
+
+    `peq[c * stride]` holds the match mask of character `c`.
+*/
+inline long long bitpar_levenshtein_word(const uint64_t *peq, size_t stride, size_t m,
+                                         std::string_view text) {
+    if (0 == m) {
+        return (long long)text.length();
+    }
+
+    const uint64_t last = 1ull << (m - 1);
+    uint64_t VP = ~0ull;
+    uint64_t VN = 0;
+    long long distance = (long long)m;
+
+    for (unsigned char c : text) {
+        const uint64_t X = peq[c * stride] | VN;
+        const uint64_t D0 = (((X & VP) + VP) ^ VP) | X;
+        uint64_t HP = VN | ~(D0 | VP);
+        uint64_t HN = VP & D0;
+        distance += (HP & last) ? 1 : 0;
+        distance -= (HN & last) ? 1 : 0;
+        HP = (HP << 1) | 1;
+        HN = HN << 1;
+        VP = HN | ~(D0 | HP);
+        VN = HP & D0;
+    }
+
+    return distance;
+}
+
+// Multi-word version of `bitpar_levenshtein_word()` for patterns of any length. The
+// masks are laid out as `peq[c * stride + w]` and `blocks` must have room for
+// ceil(m/64) entries. Costs ceil(m/64) word operations per text character.
+inline long long bitpar_levenshtein_blocks(const uint64_t *peq, size_t stride, size_t m,
+                                           std::string_view text, BitparBlock *blocks) {
+    if (0 == m) {
+        return (long long)text.length();
+    }
+
+    const size_t words = (m + BITPAR_WORD_BITS - 1) / BITPAR_WORD_BITS;
+    const uint64_t last = 1ull << ((m - 1) % BITPAR_WORD_BITS);
+    for (size_t w = 0; w < words; ++w) {
+        blocks[w].VP = ~0ull;
+        blocks[w].VN = 0;
+    }
+    long long distance = (long long)m;
+
+    for (unsigned char c : text) {
+        const uint64_t *masks = peq + c * stride;
+        // Horizontal difference entering the top of each block. Row 0 always grows.
+        uint64_t HP_carry = 1;
+        uint64_t HN_carry = 0;
+
+        for (size_t w = 0; w < words; ++w) {
+            const uint64_t VP = blocks[w].VP;
+            const uint64_t VN = blocks[w].VN;
+            const uint64_t X = masks[w] | HN_carry;
+            const uint64_t D0 = (((X & VP) + VP) ^ VP) | X | VN;
+            uint64_t HP = VN | ~(D0 | VP);
+            uint64_t HN = VP & D0;
+
+            const uint64_t HP_out = HP >> (BITPAR_WORD_BITS - 1);
+            const uint64_t HN_out = HN >> (BITPAR_WORD_BITS - 1);
+            if (w + 1 == words) {
+                distance += (HP & last) ? 1 : 0;
+                distance -= (HN & last) ? 1 : 0;
+            }
+            HP = (HP << 1) | HP_carry;
+            HN = (HN << 1) | HN_carry;
+            HP_carry = HP_out;
+            HN_carry = HN_out;
+
+            blocks[w].VP = HN | ~(D0 | HP);
+            blocks[w].VN = HP & D0;
+        }
+    }
+
+    return distance;
+}
+
+/*
+    Approximate substring search: the smallest optimal string alignment distance between
+    a pattern of `m` characters and any substring of `text`, with the pattern's match
+    masks in `peq[c * stride]`.
+
+    This is the search mode of the recurrences above. A match may start anywhere in the
+    text, so row 0 of the matrix is all zeros and no horizontal difference enters the
+    top of the pattern; it may end anywhere, so the answer is the smallest value the
+    last row takes. The cost is one pass over the text, whatever the pattern matches.
+*/
+inline long long bitpar_osa_search_word(const uint64_t *peq, size_t stride, size_t m,
+                                        std::string_view text) {
+    if (0 == m) {
+        return 0;
+    }
+
+    const uint64_t last = 1ull << (m - 1);
+    uint64_t VP = ~0ull;
+    uint64_t VN = 0;
+    uint64_t D0 = 0;
+    uint64_t PM_prev = 0;
+    long long distance = (long long)m;
+    long long best = distance;
+
+    for (unsigned char c : text) {
+        const uint64_t PM = peq[c * stride];
+        const uint64_t TR = (((~D0) & PM) << 1) & PM_prev;
+        D0 = (((PM & VP) + VP) ^ VP) | PM | VN | TR;
+
+        uint64_t HP = VN | ~(D0 | VP);
+        uint64_t HN = D0 & VP;
+        distance += (HP & last) ? 1 : 0;
+        distance -= (HN & last) ? 1 : 0;
+        best = std::min(best, distance);
+        if (0 == best) {
+            break;
+        }
+
+        HP = HP << 1;
+        HN = HN << 1;
+        VP = HN | ~(D0 | HP);
+        VN = HP & D0;
+        PM_prev = PM;
+    }
+
+    return best;
+}
+
+/*
+    Multi-word version of `bitpar_osa_search_word()`, for patterns of any length. The
+    masks are laid out as `peq[c * stride + w]` and `blocks` must have room for
+    ceil(m/64) entries.
+
+    Only a distance of at most `max` is of interest, so this uses Myers' cut-off: a
+    column only has to be evaluated down to the last block that still holds a cell of
+    value at most `max`. Cells below it are treated as if they grew by one per row,
+    which can only overestimate them. Searching for a pattern that is rarely close to
+    the text then costs about ceil(max/64) words per text character, not ceil(m/64).
+
+    Returns some value greater than `max` if no substring is that close.
+*/
+inline long long bitpar_osa_search_blocks(const uint64_t *peq, size_t stride, size_t m,
+                                          std::string_view text, long long max,
+                                          BitparBlock *blocks) {
+    if (0 == m) {
+        return 0;
+    }
+    const long long W = (long long)BITPAR_WORD_BITS;
+    const long long rows = (long long)m;
+    const long long last_block = (rows - 1) / W;
+    const uint64_t last_bit = 1ull << ((rows - 1) % W);
+    // The number of rows in block b.
+    auto height = [&](long long b) { return std::min(W, rows - b * W); };
+
+    // Blocks 0 to y are evaluated. Cells in the first column are their row number, so
+    // this is the last block that starts at most `max` rows down.
+    long long y = std::min(last_block, std::max(0ll, max) / W);
+    for (long long b = 0; b <= y; ++b) {
+        blocks[b].VP = ~0ull;
+        blocks[b].VN = 0;
+        blocks[b].D0 = 0;
+        blocks[b].PM = 0;
+        blocks[b].score = b * W + height(b);
+    }
+    long long best = last_block == y ? rows : max + 1;
+
+    const uint64_t *previous_masks = nullptr;
+    for (unsigned char c : text) {
+        const uint64_t *masks = peq + c * stride;
+        uint64_t HP_carry = 0;
+        uint64_t HN_carry = 0;
+        uint64_t TR_carry = 0;
+
+        for (long long b = 0; b <= y; ++b) {
+            BitparBlock &block = blocks[b];
+            const uint64_t PM = masks[b];
+            const uint64_t VP = block.VP;
+            const uint64_t VN = block.VN;
+            const uint64_t TR = ((((~block.D0) & PM) << 1) | TR_carry) & block.PM;
+            TR_carry = ((~block.D0) & PM) >> (W - 1);
+
+            const uint64_t X = PM | HN_carry;
+            const uint64_t D0 = (((X & VP) + VP) ^ VP) | X | VN | TR;
+            uint64_t HP = VN | ~(D0 | VP);
+            uint64_t HN = D0 & VP;
+
+            const bool last_word = b == last_block;
+            const uint64_t HP_out = last_word ? ((HP & last_bit) ? 1 : 0) : HP >> (W - 1);
+            const uint64_t HN_out = last_word ? ((HN & last_bit) ? 1 : 0) : HN >> (W - 1);
+            HP = (HP << 1) | HP_carry;
+            HN = (HN << 1) | HN_carry;
+            HP_carry = HP_out;
+            HN_carry = HN_out;
+
+            block.VP = HN | ~(D0 | HP);
+            block.VN = HP & D0;
+            block.D0 = D0;
+            block.PM = PM;
+            block.score += (long long)HP_out - (long long)HN_out;
+
+            // Diagonals never decrease, so the last cell within `max` moves down by at
+            // most one row per column. If it was the last row of this block in the
+            // previous column, the next block joins in now, its cells in the previous
+            // column taken to have climbed by one per row. Transpositions into its
+            // first row still come in through the carry.
+            const long long previous = block.score - (long long)HP_out + (long long)HN_out;
+            if (b == y && y < last_block && previous <= max) {
+                BitparBlock &next = blocks[b + 1];
+                next.VP = ~0ull;
+                next.VN = 0;
+                next.D0 = ~0ull;
+                next.PM = nullptr == previous_masks ? 0 : previous_masks[b + 1];
+                next.score = previous + height(b + 1);
+                ++y;
+            }
+        }
+
+        // Drop trailing blocks none of whose cells are within `max`, since cells in a
+        // column differ by at most one from their neighbours.
+        while (y > 0 && blocks[y].score - height(y) + 1 > max) {
+            --y;
+        }
+
+        if (y == last_block) {
+            best = std::min(best, blocks[y].score);
+            if (0 == best) {
+                break;
+            }
+        }
+        previous_masks = masks;
+    }
+
+    return best;
+}
+
+// The number of set bits of `x`. std::bitset compiles to the popcount instruction
+// where there is one, and to a portable loop elsewhere.
+inline long long bitpar_popcount(uint64_t x) {
+    return (long long)std::bitset<BITPAR_WORD_BITS>(x).count();
+}
+
+/*
+    Length of the longest common subsequence of `text` and a pattern of `m <= 64`
+    characters, using the algorithm of
+
+        H. Hyyrö, "Bit-Parallel LCS-length Computation Revisited", Proceedings of the
+        15th Australasian Workshop on Combinatorial Algorithms (2004).
+
+    A zero bit in V marks a row where the LCS grows by one, so the column is updated
+    with a single addition and the LCS is the number of zero bits in the end. Returns
+    early with some value below `min_lcs` once the rest of the text can no longer
+    bring the LCS up to it.
+*/
+inline long long bitpar_lcs_word(const uint64_t *peq, size_t stride, size_t m,
+                                 std::string_view text, long long min_lcs) {
+    if (0 == m) {
+        return 0;
+    }
+
+    const uint64_t mask = m == BITPAR_WORD_BITS ? ~0ull : (1ull << m) - 1;
+    uint64_t V = ~0ull;
+    const size_t n = text.length();
+
+    for (size_t j = 0; j < n; ++j) {
+        const uint64_t U = V & peq[(unsigned char)text[j] * stride];
+        V = (V + U) | (V - U);
+        // Each remaining character adds at most one. Only checked once a word's worth
+        // of text has gone by, to keep the count off the critical path.
+        if (0 == (j + 1) % BITPAR_WORD_BITS) {
+            const long long lcs = bitpar_popcount(~V & mask);
+            if (lcs + (long long)(n - j - 1) < min_lcs) {
+                return lcs + (long long)(n - j - 1);
+            }
+        }
+    }
+
+    return bitpar_popcount(~V & mask);
+}
+
+// Multi-word version of `bitpar_lcs_word()` for patterns of any length, with the masks
+// laid out as `peq[c * stride + w]`. Only the `VP` of each of the ceil(m/64) `blocks`
+// is used. Costs ceil(m/64) word operations per text character.
+inline long long bitpar_lcs_blocks(const uint64_t *peq, size_t stride, size_t m,
+                                   std::string_view text, long long min_lcs,
+                                   BitparBlock *blocks) {
+    if (0 == m) {
+        return 0;
+    }
+
+    const size_t words = (m + BITPAR_WORD_BITS - 1) / BITPAR_WORD_BITS;
+    const uint64_t last_mask = 0 == m % BITPAR_WORD_BITS
+                                       ? ~0ull
+                                       : (1ull << (m % BITPAR_WORD_BITS)) - 1;
+    for (size_t w = 0; w < words; ++w) {
+        blocks[w].VP = ~0ull;
+    }
+    auto count = [&]() {
+        long long lcs = 0;
+        for (size_t w = 0; w + 1 < words; ++w) {
+            lcs += bitpar_popcount(~blocks[w].VP);
+        }
+        return lcs + bitpar_popcount(~blocks[words - 1].VP & last_mask);
+    };
+    const size_t n = text.length();
+
+    for (size_t j = 0; j < n; ++j) {
+        const uint64_t *masks = peq + (unsigned char)text[j] * stride;
+        // The addition carries from the bottom of one block into the next.
+        uint64_t carry = 0;
+        for (size_t w = 0; w < words; ++w) {
+            const uint64_t V = blocks[w].VP;
+            const uint64_t U = V & masks[w];
+            // An unsigned sum wrapped around if it came out smaller than an addend.
+            uint64_t sum = V + U;
+            const uint64_t overflow = sum < V ? 1 : 0;
+            sum += carry;
+            carry = overflow | (sum < carry ? 1 : 0);
+            blocks[w].VP = sum | (V - U);
+        }
+        if (0 == (j + 1) % BITPAR_WORD_BITS) {
+            const long long lcs = count();
+            if (lcs + (long long)(n - j - 1) < min_lcs) {
+                return lcs + (long long)(n - j - 1);
+            }
+        }
+    }
+
+    return count();
+}
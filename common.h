@@ -24,3 +24,36 @@
 // Silences warning in gcc/clang.
 #define UNUSED __attribute__((unused))
 #endif
+
+// The string argument at `index`, with NULL as the empty string.
+inline std::string_view damlev_string(UDF_ARGS *args, unsigned index) {
+    if (args->args[index] == nullptr) {
+        return {};
+    }
+    return {args->args[index], args->lengths[index]};
+}
+
+// Bits of the optional flags argument some of the functions take.
+// Compare code points instead of bytes (see utf8.h).
+constexpr long long DAMLEV_UTF8 = 1;
+// Compare letters regardless of case, and of accents (see fold.h).
+constexpr long long DAMLEV_FOLD_CASE = 2;
+constexpr long long DAMLEV_FOLD_ACCENTS = 4;
+
+constexpr const char DAMLEV_FLAGS_ERROR[] = "The flags argument must be a constant integer.";
+constexpr const auto DAMLEV_FLAGS_ERROR_LEN = std::size(DAMLEV_FLAGS_ERROR) + 1;
+
+// Reads the flags argument at `index`, if there is one, into `flags`. Flags change how
+// the strings are prepared for the whole statement, so they have to be constant.
+// Returns false if they are not.
+inline bool damlev_flags(UDF_ARGS *args, unsigned index, long long &flags) {
+    flags = 0;
+    if (args->arg_count <= index) {
+        return true;
+    }
+    if (args->arg_type[index] != INT_RESULT || args->args[index] == nullptr) {
+        return false;
+    }
+    flags = *((long long *)args->args[index]);
+    return true;
+}
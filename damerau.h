@@ -0,0 +1,142 @@
+/*
+    The unrestricted Damerau–Levenshtein distance, computed with the algorithm of
+    Lowrance and Wagner.
+
+    Unlike the optimal string alignment distance in osa.h, a transposed pair may be
+    edited further, so "ca" -> "abc" costs 2 instead of 3. This makes the distance a
+    true metric, which is what metric indexes need in order to prune safely.
+
+    The transposition term looks back to D[k-1][l-1], where k is the last row whose
+    character of `a` matches b[j-1] and l is the last column in this row whose
+    character of `b` matches a[i-1]. Row k-1 can be arbitrarily far up, but it is
+    always the row above the last occurrence of some character of `a`. So instead of
+    the whole matrix, one row is kept per distinct character of `a`, plus the two
+    rolling rows. When a character occurs again, its old row is recycled as the next
+    scratch row, so no row is ever copied.
+
+    R. Lowrance and R. A. Wagner, "An Extension of the String-to-String Correction
+    Problem", Journal of the ACM 22 (1975).
+
+    Released under the MIT license. See LICENSE.txt.
+*/
+
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string_view>
+#include <vector>
+
+constexpr size_t DAMERAU_ALPHABET_SIZE = 256;
+
+/*
+    Per-statement state. The per-character tables are only valid for the characters
+    whose `seen` stamp equals `generation`, so moving on to the next pair of strings
+    is a single increment instead of clearing them.
+*/
+struct DamerauBuffer {
+    // Rows of m + 1 cells each.
+    std::vector<uint32_t> rows;
+    uint32_t generation;
+    uint32_t seen[DAMERAU_ALPHABET_SIZE];
+    // The last row of `a` the character occurred in, or 0.
+    uint32_t last_row[DAMERAU_ALPHABET_SIZE];
+    // The index in `rows` of the row above that occurrence.
+    uint32_t saved[DAMERAU_ALPHABET_SIZE];
+
+    DamerauBuffer() : generation(0) {
+        std::memset(seen, 0, sizeof(seen));
+    }
+};
+
+// Computes the distance between `a` and `b` in O(n*m) time and O(s*min(n, m)) memory,
+// where s is the number of distinct characters in the longer string.
+inline size_t damerau_distance(std::string_view a, std::string_view b, DamerauBuffer &buffer) {
+    // The distance is symmetric, so keep the rows as short as possible.
+    if (b.length() > a.length()) {
+        std::swap(a, b);
+    }
+    const size_t n = a.length();
+    const size_t m = b.length();
+    if (0 == m) {
+        return n;
+    }
+
+    if (0 == ++buffer.generation) {
+        // Wrapped around; stamps from 2^32 calls ago would look current.
+        std::memset(buffer.seen, 0, sizeof(buffer.seen));
+        buffer.generation = 1;
+    }
+    const uint32_t generation = buffer.generation;
+    constexpr uint32_t none = UINT32_MAX;
+
+    // Two rolling rows, and at most one saved row per distinct character of `a`.
+    size_t row_count = 2;
+    for (const char c : a) {
+        const auto ch = (unsigned char)c;
+        if (buffer.seen[ch] != generation) {
+            buffer.seen[ch] = generation;
+            buffer.last_row[ch] = 0;
+            buffer.saved[ch] = none;
+            ++row_count;
+        }
+    }
+    const size_t stride = m + 1;
+    if (buffer.rows.size() < row_count * stride) {
+        buffer.rows.resize(row_count * stride);
+    }
+    uint32_t *rows = buffer.rows.data();
+    uint32_t above = 0;
+    uint32_t current = 1;
+    uint32_t next_free = 2;
+
+    for (size_t j = 0; j <= m; ++j) {
+        rows[j] = (uint32_t)j;
+    }
+
+    for (size_t i = 1; i <= n; ++i) {
+        const uint32_t *up = rows + above * stride;
+        uint32_t *row = rows + current * stride;
+        const auto a_i = (unsigned char)a[i - 1];
+        row[0] = (uint32_t)i;
+        // The last column in this row whose character matched a[i-1].
+        size_t last_column = 0;
+
+        for (size_t j = 1; j <= m; ++j) {
+            const auto b_j = (unsigned char)b[j - 1];
+            const size_t k = buffer.seen[b_j] == generation ? buffer.last_row[b_j] : 0;
+            const size_t l = last_column;
+            uint32_t cost = 1;
+            if (a_i == b_j) {
+                cost = 0;
+                last_column = j;
+            }
+            uint32_t value = std::min({up[j] + 1,         // D[i-1][j]
+                                       row[j - 1] + 1,    // D[i][j-1]
+                                       up[j - 1] + cost}); // D[i-1][j-1]
+            if (k > 0 && l > 0) {
+                // Transpose a[k-1] and a[i-1] with b[l-1] and b[j-1], deleting
+                // everything between them in `a` and inserting everything between
+                // them in `b`.
+                const uint32_t *saved = rows + (size_t)buffer.saved[b_j] * stride;
+                value = std::min(value, saved[l - 1] + (uint32_t)((i - k - 1) + 1 + (j - l - 1)));
+            }
+            row[j] = value;
+        }
+
+        // The row above becomes the saved row for a[i-1], and the one it replaces
+        // (or a fresh one) becomes the next scratch row.
+        uint32_t recycled = buffer.saved[a_i];
+        if (none == recycled) {
+            recycled = next_free++;
+        }
+        buffer.saved[a_i] = above;
+        buffer.last_row[a_i] = (uint32_t)i;
+        above = current;
+        current = recycled;
+    }
+
+    return rows[above * stride + m];
+}
@@ -12,10 +12,13 @@
 
     Syntax:
 
-        DAMLEV(String1, String2, PosInt);
+        DAMLEV(String1, String2[, Flags]);
 
     `String1`:  A string constant or column.
     `String2`:  A string constant or column to be compared to `String1`.
+    `Flags`:    An optional integer constant, the sum of any of: 1 to compare UTF-8
+                code points instead of bytes, so that "é" is one character; 2 to
+                ignore case; 4 to ignore accents, so that "é" matches "e" (see fold.h).
 
     Returns: An integer equal to the edit distance between `String1` and `String2`.
 
@@ -58,6 +61,10 @@
 #include <cmath>
 
 #include "common.h"
+#include "osa_short.h"
+#include "osa_simd.h"
+#include "fold.h"
+#include "utf8.h"
 //#define PRINT_DEBUG
 #ifdef PRINT_DEBUG
 #include <iostream>
@@ -69,7 +76,7 @@
     // 640k should be good enough for anybody.
     #define DAMLEV_BUFFER_SIZE 512ull
 #endif
-constexpr long long DAMLEV_MAX_EDIT_DIST = std::max(0ull, std::min(16384ull, DAMLEV_BUFFER_SIZE));
+constexpr long long DAMLEV_MAX_EDIT_DIST = DAMLEV_BUFFER_SIZE;
 
 // Error messages.
 // MySQL error messages can be a maximum of MYSQL_ERRMSG_SIZE bytes long. In
@@ -77,17 +84,19 @@ constexpr long long DAMLEV_MAX_EDIT_DIST = std::max(0ull, std::min(16384ull, DAM
 // keep the error message less than 80 bytes long!" Rules were meant to be
 // broken.
 constexpr const char
-        DAMLEV_ARG_NUM_ERROR[] = "Wrong number of arguments. DAMLEV() requires two arguments:\n"
+        DAMLEV_ARG_NUM_ERROR[] = "Wrong number of arguments. DAMLEV() requires two or three arguments:\n"
                                  "\t1. A string.\n"
-                                 "\t2. Another string.";
+                                 "\t2. Another string.\n"
+                                 "\t3. Optionally, flags (1 for UTF-8, 2 to fold case, 4 to fold accents).";
 constexpr const auto DAMLEV_ARG_NUM_ERROR_LEN = std::size(DAMLEV_ARG_NUM_ERROR) + 1;
 constexpr const char DAMLEV_MEM_ERROR[] = "Failed to allocate memory for DAMLEV"
                                           " function.";
 constexpr const auto DAMLEV_MEM_ERROR_LEN = std::size(DAMLEV_MEM_ERROR) + 1;
 constexpr const char
-        DAMLEV_ARG_TYPE_ERROR[] = "Arguments have wrong type. DAMLEV() requires two arguments:\n"
+        DAMLEV_ARG_TYPE_ERROR[] = "Arguments have wrong type. DAMLEV() requires two or three arguments:\n"
                                   "\t1. A string.\n"
-                                  "\t2. Another string.";
+                                  "\t2. Another string.\n"
+                                  "\t3. Optionally, flags (1 for UTF-8, 2 to fold case, 4 to fold accents).";
 constexpr const auto DAMLEV_ARG_TYPE_ERROR_LEN = std::size(DAMLEV_ARG_TYPE_ERROR) + 1;
 
 // Use a "C" calling convention.
@@ -97,9 +106,17 @@ long long damlev(UDF_INIT *initid, UDF_ARGS *args, char *is_null, char *error);
 void damlev_deinit(UDF_INIT *initid);
 }
 
+struct DamlevData {
+    OsaBuffer buffer;
+    long long flags;
+    FoldBuffer fold;
+    // The strings rewritten one byte per code point, in UTF-8 mode.
+    Utf8Buffer utf8;
+};
+
 bool damlev_init(UDF_INIT *initid, UDF_ARGS *args, char *message) {
-    // We require 2 arguments:
-    if (args->arg_count != 2) {
+    // We require 2 or 3 arguments:
+    if (args->arg_count != 2 && args->arg_count != 3) {
         strncpy(message, DAMLEV_ARG_NUM_ERROR, DAMLEV_ARG_NUM_ERROR_LEN);
         return 1;
     }
@@ -108,13 +125,20 @@ bool damlev_init(UDF_INIT *initid, UDF_ARGS *args, char *message) {
         strncpy(message, DAMLEV_ARG_TYPE_ERROR, DAMLEV_ARG_TYPE_ERROR_LEN);
         return 1;
     }
+    long long flags;
+    if (!damlev_flags(args, 2, flags)) {
+        strncpy(message, DAMLEV_FLAGS_ERROR, DAMLEV_FLAGS_ERROR_LEN);
+        return 1;
+    }
 
     // Attempt to allocate a buffer.
-    initid->ptr = (char *)new(std::nothrow) std::vector<size_t>((DAMLEV_MAX_EDIT_DIST));
-    if (initid->ptr == nullptr) {
+    DamlevData *data = new(std::nothrow) DamlevData();
+    if (data == nullptr) {
         strncpy(message, DAMLEV_MEM_ERROR, DAMLEV_MEM_ERROR_LEN);
         return 1;
     }
+    data->flags = flags;
+    initid->ptr = (char *)data;
 
     // damlev does not return null.
     initid->maybe_null = 0;
@@ -122,38 +146,50 @@ bool damlev_init(UDF_INIT *initid, UDF_ARGS *args, char *message) {
 }
 
 void damlev_deinit(UDF_INIT *initid) {
-    delete[] initid->ptr;
+    delete (DamlevData *)initid->ptr;
 }
 
 long long damlev(UDF_INIT *initid, UDF_ARGS *args, UNUSED char *is_null, UNUSED char *error) {
     // Retrieve the arguments.
 
-    //set max string lenght for later
-    const double max_string_length = static_cast<double>(std::max(args->lengths[0],
-                                                                  args->lengths[1]));
     // we don't get a LD limit, so set at max string lenght
     //const long long int max = max_string_length;
 
-    if (args->lengths[0] == 0 || args->lengths[1] == 0 || args->args[1] == nullptr
-        || args->args[0] == nullptr) {
-        // Either one of the strings doesn't exist, or one of the strings has
-        // length zero. In either case
-        return (long long) std::max(args->lengths[0], args->lengths[1]);
-    }
 #ifdef PRINT_DEBUG
-    std::cout << "Maximum edit distance:" <<  std::min(*((long long *)args->args[2]),
-                                                       DAMLEV_MAX_EDIT_DIST)<<std::endl;
-    std::cout << "DAMLEVCONST_MAX_EDIT_DIST:" <<DAMLEV_MAX_EDIT_DIST<<std::endl;
     std::cout << "Max String Length:" << static_cast<double>(std::max(args->lengths[0],
                                                                       args->lengths[1]))<<std::endl;
 
 #endif
     // Retrieve buffer.
-    std::vector<size_t> &buffer = *(std::vector<size_t> *) initid->ptr;
+    DamlevData &data = *(DamlevData *)initid->ptr;
+    OsaBuffer &buffer = data.buffer;
 
     // Let's make some string views so we can use the STL.
-    std::string_view subject{args->args[0], args->lengths[0]};
-    std::string_view query{args->args[1], args->lengths[1]};
+    std::string_view subject{args->args[0] ? args->args[0] : "",
+                             args->args[0] ? args->lengths[0] : 0};
+    std::string_view query{args->args[1] ? args->args[1] : "",
+                           args->args[1] ? args->lengths[1] : 0};
+
+    // Fold case and accents first, so that everything after sees the folded strings.
+    subject = fold_string(subject, data.flags, data.fold.a);
+    query = fold_string(query, data.flags, data.fold.b);
+
+    // From here on a character is a byte, so rewrite the strings that way.
+    if ((data.flags & DAMLEV_UTF8) && !utf8_prepare(subject, query, data.utf8)) {
+        return utf8_wide_distance(data.utf8.wide_a, data.utf8.wide_b, data.utf8.wide_rows);
+    }
+
+    if (subject.empty() || query.empty()) {
+        // Either one of the strings doesn't exist, or one of the strings has
+        // length zero. In either case
+        return (long long) std::max(subject.length(), query.length());
+    }
+
+    // Codes and names fit in a register, and a kernel built for the exact length
+    // beats trimming them.
+    if (subject.length() <= OSA_SHORT_MAX_LENGTH && query.length() <= OSA_SHORT_MAX_LENGTH) {
+        return osa_short_distance(subject, query);
+    }
 
     // Skip any common prefix.
     auto [subject_begin, query_begin] =
@@ -201,67 +237,12 @@ long long damlev(UDF_INIT *initid, UDF_ARGS *args, UNUSED char *is_null, UNUSED
     }
 
 
-    int trimmed_max = std::max(int(query.length()), int(subject.length()));
-    int max = trimmed_max;
 #ifdef PRINT_DEBUG
-    std::cout << "trimmed max length:" <<trimmed_max<<std::endl;
     std::cout << "trimmed subject= " <<subject <<std::endl;
     std::cout <<"trimmed constant query= " <<query<<std::endl;
 #endif
 
-    // Make "subject" the smaller one.
-    if (query.length() < subject.length()) {
-
-        std::swap(subject, query);
-
-    }
-
-
-    // If one of the strings is a suffix of the other.
-    if (subject.length() == 0) {
-#ifdef PRINT_DEBUG
-        std::cout << subject << " is a suffix of " << query << ", bailing" << std::endl;
-#endif
-        return query.length();
-    }
-
-    int n = subject.size();
-    int m = query.size();
-
-    // Resize buffer to simulate a 2D matrix
-    buffer.resize((n + 1) * (m + 1));
-
-    // Function to access the 2D matrix simulated in a 1D vector
-    auto idx = [m](int i, int j) { return i * (m + 1) + j; };
-
-    // Initialize first row and column
-    for (int i = 0; i <= n; i++) {
-        buffer[idx(i, 0)] = i;
-    }
-    for (int j = 0; j <= m; j++) {
-        buffer[idx(0, j)] = j;
-    }
-
-    for (int i = 1; i <= n; i++) {
-        size_t column_min = trimmed_max + 1;
-        for (int j = 1; j <= m; j++) {
-            int cost = (subject[i - 1] == query[j - 1]) ? 0 : 1;
-
-            buffer[idx(i, j)] = std::min({ buffer[idx(i - 1, j)] + 1,
-                                           buffer[idx(i, j - 1)] + 1,
-                                           buffer[idx(i - 1, j - 1)] + cost });
-
-            if (i > 1 && j > 1 && subject[i - 1] == query[j - 2] && subject[i - 2] == query[j - 1]) {
-                buffer[idx(i, j)] = std::min(buffer[idx(i, j)], buffer[idx(i - 2, j - 2)] + cost);
-            }
-
-            column_min = std::min(column_min, buffer[idx(i, j)]);
-        }
-
-        if (column_min > max) {
-            return max_string_length;
-        }
-    }
-    buffer.resize(DAMLEV_MAX_EDIT_DIST);
-    return buffer[idx(n, m)];
-}
\ No newline at end of file
+    // There is no limit: medium-length pairs go to the vectorised kernel, and
+    // everything else widens the band until it is wide enough to prove the distance.
+    return osa_distance(subject, query, buffer);
+}
@@ -58,7 +58,7 @@
     IN THE SOFTWARE.
 */
 #include "common.h"
-#include <vector>
+#include "bitparallel.h"
 //#define PRINT_DEBUG
 #ifdef PRINT_DEBUG
 #include <iostream>
@@ -71,7 +71,7 @@
 // 640k should be good enough for anybody.
 #define DAMLEV_BUFFER_SIZE 512ull
 #endif
-constexpr long long EDIT_DISTANCE_MAX_EDIT_DIST = std::max(0ull, std::min(16384ull, DAMLEV_BUFFER_SIZE));
+constexpr long long EDIT_DISTANCE_MAX_EDIT_DIST = DAMLEV_BUFFER_SIZE;
 
 // Error messages.
 // MySQL error messages can be a maximum of MYSQL_ERRMSG_SIZE bytes long. In
@@ -111,12 +111,15 @@ bool damlev2D_init(UDF_INIT *initid, UDF_ARGS *args, char *message) {
         return 1;
     }
 
-    // Attempt to allocate a buffer.
-    initid->ptr = (char *)new(std::nothrow) std::vector<size_t>((EDIT_DISTANCE_MAX_EDIT_DIST));
-    if (initid->ptr == nullptr) {
+    // Attempt to allocate the match masks. One block covers most strings; longer ones
+    // grow the arena as they come along.
+    BitparArena *arena = new(std::nothrow) BitparArena();
+    if (nullptr == arena || !bitpar_arena_reserve(*arena, 1)) {
+        delete arena;
         strncpy(message, EDIT_DISTANCE_MEM_ERROR, EDIT_DISTANCE_MEM_ERROR_LEN);
         return 1;
     }
+    initid->ptr = (char *)arena;
 
     // damlev2D does not return null.
     initid->maybe_null = 0;
@@ -124,52 +127,41 @@ bool damlev2D_init(UDF_INIT *initid, UDF_ARGS *args, char *message) {
 }
 
 void damlev2D_deinit(UDF_INIT *initid) {
-    delete[] initid->ptr;
+    BitparArena *arena = (BitparArena *)initid->ptr;
+    bitpar_arena_free(*arena);
+    delete arena;
 }
 
-long long damlev2D(UDF_INIT *initid, UDF_ARGS *args, UNUSED char *is_null, UNUSED char *error) {
+long long damlev2D(UDF_INIT *initid, UDF_ARGS *args, UNUSED char *is_null, char *error) {
 
+    if (args->args[0] == nullptr || args->args[1] == nullptr) {
+        return (long long)std::max(args->lengths[0], args->lengths[1]);
+    }
     std::string_view S1{args->args[0], args->lengths[0]};
     std::string_view S2{args->args[1], args->lengths[1]};
 
-    //https://takeuforward.org/data-structure/edit-distance-dp-33/
-    int n = S1.size();
-    int m = S2.size();
-
-    std::vector<int> prev(m+1,0);
-    std::vector<int> cur(m+1,0);
+    // Myers' bit-parallel algorithm keeps a whole DP column in ceil(m/64) words, so put
+    // the shorter string in the bits.
+    if (S2.length() < S1.length()) {
+        std::swap(S1, S2);
+    }
+    const size_t m = S1.size();
 
-    int cost;
-    for(int j=0;j<=m;j++){
-        prev[j] = j;
+    BitparArena &arena = *(BitparArena *)initid->ptr;
+    const size_t words = (m + BITPAR_WORD_BITS - 1) / BITPAR_WORD_BITS;
+    if (!bitpar_arena_reserve(arena, words)) {
+        *error = 1;
+        return 0;
     }
 
-    for(int i=1;i<n+1;i++){
-        cur[0]=i;
-
-        for(int j=1;j<m+1;j++){
-            if(S1[i-1]==S2[j-1]){
-                cur[j] = 0+prev[j-1];
-                cost = 0;
-            }
-
-            else {
-                cur[j] = 1 + std::min(prev[j - 1], std::min(prev[j], cur[j - 1]));
-                cost = 1;
-            }
-            if( (i > 1) &&
-                (j > 1) &&
-                (S1[i-1] == S2[j-2]) &&
-                (S1[i-2] == S2[j-1])
-                    )
-            {
-                cur[j] = std::min(
-                        cur[j],
-                        prev[j-1]  +cost  // transposition
-                );
-            }
-        } prev = cur;
+    bitpar_arena_set(arena, S1);
+    long long distance;
+    if (m <= BITPAR_WORD_BITS) {
+        distance = bitpar_levenshtein_word(arena.peq, arena.words, m, S2);
+    } else {
+        distance = bitpar_levenshtein_blocks(arena.peq, arena.words, m, S2, arena.blocks);
     }
+    bitpar_arena_clear(arena, S1);
 
-    return prev[m];
-}
\ No newline at end of file
+    return distance;
+}
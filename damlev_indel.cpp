@@ -0,0 +1,204 @@
+/*
+    Insertion/Deletion Edit Distance UDF for MySQL.
+
+    <hr>
+    `DAMLEV_INDEL()` computes the edit distance between two strings when the only
+    edits allowed are inserting and deleting characters, which is the number of
+    characters the two strings do not have in their longest common subsequence. A
+    substitution counts as two edits, so this is a stricter measure of duplication
+    than `DAMLEV()`.
+
+    Syntax:
+
+        DAMLEV_INDEL(String1, String2[, PosInt]);
+
+    `String1`:  A string constant or column.
+    `String2`:  A string constant or column to be compared to `String1`.
+    `PosInt`:   An optional positive integer. If the distance between `String1` and
+                `String2` is greater than `PosInt`, `DAMLEV_INDEL()` may stop early
+                and return the sum of their lengths, which is always an upper bound.
+
+    Returns: Either an integer equal to the insertion/deletion distance between
+    `String1` and `String2`, or the sum of their lengths.
+
+    Example Usage:
+
+        SELECT Name FROM CUSTOMERS
+            WHERE DAMLEV_INDEL(Name, "Vladimir Iosifovich Levenshtein", 4) <= 4;
+
+    The above will return every `Name` that can be turned into "Vladimir Iosifovich
+    Levenshtein" by inserting and deleting at most four characters.
+
+    <hr>
+
+    The longest common subsequence is computed with Hyyrö's bit-parallel recurrence
+    (see bitparallel.h), which costs ceil(m/64) word operations per character of the
+    longer string.
+
+    Released under the MIT license.
+
+    The MIT License
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to
+    deal in the Software without restriction, including without limitation the
+    rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+    sell copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in
+    all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+    IN THE SOFTWARE.
+*/
+#include "common.h"
+#include "bitparallel.h"
+//#define PRINT_DEBUG
+#ifdef PRINT_DEBUG
+#include <iostream>
+#endif
+
+// Error messages.
+// MySQL error messages can be a maximum of MYSQL_ERRMSG_SIZE bytes long. In
+// version 8.0, MYSQL_ERRMSG_SIZE == 512. However, the example says to "try to
+// keep the error message less than 80 bytes long!" Rules were meant to be
+// broken.
+constexpr const char
+        DAMLEV_INDEL_ARG_NUM_ERROR[] = "Wrong number of arguments. DAMLEV_INDEL() requires two or three arguments:\n"
+                                       "\t1. A string.\n"
+                                       "\t2. Another string.\n"
+                                       "\t3. Optionally, a maximum distance (0 <= int).";
+constexpr const auto DAMLEV_INDEL_ARG_NUM_ERROR_LEN = std::size(DAMLEV_INDEL_ARG_NUM_ERROR) + 1;
+constexpr const char DAMLEV_INDEL_MEM_ERROR[] = "Failed to allocate memory for DAMLEV_INDEL"
+                                                " function.";
+constexpr const auto DAMLEV_INDEL_MEM_ERROR_LEN = std::size(DAMLEV_INDEL_MEM_ERROR) + 1;
+constexpr const char
+        DAMLEV_INDEL_ARG_TYPE_ERROR[] = "Arguments have wrong type. DAMLEV_INDEL() requires two or three arguments:\n"
+                                        "\t1. A string.\n"
+                                        "\t2. Another string.\n"
+                                        "\t3. Optionally, a maximum distance (0 <= int).";
+constexpr const auto DAMLEV_INDEL_ARG_TYPE_ERROR_LEN = std::size(DAMLEV_INDEL_ARG_TYPE_ERROR) + 1;
+
+// Use a "C" calling convention.
+extern "C" {
+bool damlev_indel_init(UDF_INIT *initid, UDF_ARGS *args, char *message);
+long long damlev_indel(UDF_INIT *initid, UDF_ARGS *args, char *is_null, char *error);
+void damlev_indel_deinit(UDF_INIT *initid);
+}
+
+bool damlev_indel_init(UDF_INIT *initid, UDF_ARGS *args, char *message) {
+    // We require 2 or 3 arguments:
+    if (args->arg_count != 2 && args->arg_count != 3) {
+        strncpy(message, DAMLEV_INDEL_ARG_NUM_ERROR, DAMLEV_INDEL_ARG_NUM_ERROR_LEN);
+        return 1;
+    }
+    // The arguments needs to be of the right type.
+    else if (args->arg_type[0] != STRING_RESULT || args->arg_type[1] != STRING_RESULT ||
+             (args->arg_count == 3 && args->arg_type[2] != INT_RESULT)) {
+        strncpy(message, DAMLEV_INDEL_ARG_TYPE_ERROR, DAMLEV_INDEL_ARG_TYPE_ERROR_LEN);
+        return 1;
+    }
+
+    // Attempt to allocate the match masks. One block covers most strings; longer ones
+    // grow the arena as they come along.
+    BitparArena *arena = new(std::nothrow) BitparArena();
+    if (nullptr == arena || !bitpar_arena_reserve(*arena, 1)) {
+        delete arena;
+        strncpy(message, DAMLEV_INDEL_MEM_ERROR, DAMLEV_INDEL_MEM_ERROR_LEN);
+        return 1;
+    }
+    initid->ptr = (char *)arena;
+
+    // damlev_indel does not return null.
+    initid->maybe_null = 0;
+    return 0;
+}
+
+void damlev_indel_deinit(UDF_INIT *initid) {
+    BitparArena *arena = (BitparArena *)initid->ptr;
+    bitpar_arena_free(*arena);
+    delete arena;
+}
+
+long long damlev_indel(UDF_INIT *initid, UDF_ARGS *args, UNUSED char *is_null, char *error) {
+    // Nothing in common, so every character goes.
+    const long long none_common = (long long)(args->lengths[0] + args->lengths[1]);
+    if (args->args[0] == nullptr || args->lengths[0] == 0 || args->args[1] == nullptr ||
+        args->lengths[1] == 0) {
+        return none_common;
+    }
+    const long long max = args->arg_count == 3 && args->args[2] != nullptr
+                                  ? std::max(0ll, *((long long *)args->args[2]))
+                                  : none_common;
+
+    // Every character of the longer string without a partner has to be deleted.
+    const auto length_difference = std::max(args->lengths[0], args->lengths[1]) -
+                                   std::min(args->lengths[0], args->lengths[1]);
+    if ((long long)length_difference > max) {
+        return none_common;
+    }
+
+    std::string_view subject{args->args[0], args->lengths[0]};
+    std::string_view query{args->args[1], args->lengths[1]};
+
+    // Skip any common prefix and suffix. Unlike with transpositions, a matching end
+    // character is always part of some longest common subsequence, so the trimming is
+    // exact however short the strings are.
+    auto [subject_begin, query_begin] =
+            std::mismatch(subject.begin(), subject.end(), query.begin(), query.end());
+    const auto start_offset = (size_t)std::distance(subject.begin(), subject_begin);
+    subject.remove_prefix(start_offset);
+    query.remove_prefix(start_offset);
+    auto [subject_end, query_end] =
+            std::mismatch(subject.rbegin(), subject.rend(), query.rbegin(), query.rend());
+    const auto end_offset = (size_t)std::distance(subject.rbegin(), subject_end);
+    subject.remove_suffix(end_offset);
+    query.remove_suffix(end_offset);
+
+    if (subject.empty() || query.empty()) {
+        // One of the strings is what is left of the other with a gap taken out.
+        return (long long)(subject.length() + query.length());
+    }
+
+#ifdef PRINT_DEBUG
+    std::cout << "trimmed subject= " << subject << std::endl;
+    std::cout << "trimmed query= " << query << std::endl;
+#endif
+
+    // Put the shorter string in the bits.
+    if (query.length() < subject.length()) {
+        std::swap(subject, query);
+    }
+    const size_t m = subject.length();
+    const long long total = (long long)(m + query.length());
+    // The smallest LCS for which total - 2 * LCS <= max.
+    const long long min_lcs = (total - max + 1) / 2;
+
+    BitparArena &arena = *(BitparArena *)initid->ptr;
+    const size_t words = (m + BITPAR_WORD_BITS - 1) / BITPAR_WORD_BITS;
+    if (!bitpar_arena_reserve(arena, words)) {
+        *error = 1;
+        return 0;
+    }
+
+    bitpar_arena_set(arena, subject);
+    long long lcs;
+    if (m <= BITPAR_WORD_BITS) {
+        lcs = bitpar_lcs_word(arena.peq, arena.words, m, query, min_lcs);
+    } else {
+        lcs = bitpar_lcs_blocks(arena.peq, arena.words, m, query, min_lcs, arena.blocks);
+    }
+    bitpar_arena_clear(arena, subject);
+
+    const long long distance = total - 2 * lcs;
+    if (distance > max) {
+        return none_common;
+    }
+    return distance;
+}
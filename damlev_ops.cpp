@@ -0,0 +1,166 @@
+/*
+    Edit Script UDF for MySQL.
+
+    <hr>
+    `DAMLEV_OPS()` returns the edits that turn one string into another at the
+    Damarau Levenshtein edit distance, so that a reviewer can see which characters
+    differ instead of just how many.
+
+    Syntax:
+
+        DAMLEV_OPS(String1, String2);
+
+    `String1`:  A string constant or column.
+    `String2`:  A string constant or column to be compared to `String1`.
+
+    Returns: A string of runs of edits that turn `String1` into `String2`, read from
+    left to right. Each run is a letter followed by how many times it repeats:
+
+        =   the next character is kept.
+        S   the next character is replaced with one from `String2`.
+        I   a character from `String2` is inserted.
+        D   the next character is deleted.
+        T   the next two characters are swapped.
+
+    The number of edits other than `=` is the edit distance.
+
+    Example Usage:
+
+        SELECT DAMLEV_OPS("Levenshtein", "Levnehstien");
+
+    The above returns "=3 T2 =1 T1 =1", three transpositions.
+
+    <hr>
+
+    The edits are found with Hirschberg's divide-and-conquer (see osa_script.h), so the
+    memory needed grows with the length of the strings, not with their product.
+
+    Released under the MIT license.
+
+    The MIT License
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to
+    deal in the Software without restriction, including without limitation the
+    rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+    sell copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in
+    all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+    IN THE SOFTWARE.
+*/
+#include "common.h"
+#include "osa_script.h"
+//#define PRINT_DEBUG
+#ifdef PRINT_DEBUG
+#include <iostream>
+#endif
+
+// Error messages.
+// MySQL error messages can be a maximum of MYSQL_ERRMSG_SIZE bytes long. In
+// version 8.0, MYSQL_ERRMSG_SIZE == 512. However, the example says to "try to
+// keep the error message less than 80 bytes long!" Rules were meant to be
+// broken.
+constexpr const char
+        DAMLEV_OPS_ARG_NUM_ERROR[] = "Wrong number of arguments. DAMLEV_OPS() requires two arguments:\n"
+                                     "\t1. A string.\n"
+                                     "\t2. Another string.";
+constexpr const auto DAMLEV_OPS_ARG_NUM_ERROR_LEN = std::size(DAMLEV_OPS_ARG_NUM_ERROR) + 1;
+constexpr const char DAMLEV_OPS_MEM_ERROR[] = "Failed to allocate memory for DAMLEV_OPS"
+                                              " function.";
+constexpr const auto DAMLEV_OPS_MEM_ERROR_LEN = std::size(DAMLEV_OPS_MEM_ERROR) + 1;
+constexpr const char
+        DAMLEV_OPS_ARG_TYPE_ERROR[] = "Arguments have wrong type. DAMLEV_OPS() requires two arguments:\n"
+                                      "\t1. A string.\n"
+                                      "\t2. Another string.";
+constexpr const auto DAMLEV_OPS_ARG_TYPE_ERROR_LEN = std::size(DAMLEV_OPS_ARG_TYPE_ERROR) + 1;
+
+// Use a "C" calling convention.
+extern "C" {
+bool damlev_ops_init(UDF_INIT *initid, UDF_ARGS *args, char *message);
+char *damlev_ops(UDF_INIT *initid, UDF_ARGS *args, char *result, unsigned long *length,
+                 char *is_null, char *error);
+void damlev_ops_deinit(UDF_INIT *initid);
+}
+
+struct OpsData {
+    OsaScriptBuffer buffer;
+    std::vector<OsaEdit> edits;
+    // The result handed back to MySQL, which only has to stay valid until the next row.
+    std::string script;
+};
+
+bool damlev_ops_init(UDF_INIT *initid, UDF_ARGS *args, char *message) {
+    // We require 2 arguments:
+    if (args->arg_count != 2) {
+        strncpy(message, DAMLEV_OPS_ARG_NUM_ERROR, DAMLEV_OPS_ARG_NUM_ERROR_LEN);
+        return 1;
+    }
+    // The arguments needs to be of the right type.
+    else if (args->arg_type[0] != STRING_RESULT || args->arg_type[1] != STRING_RESULT) {
+        strncpy(message, DAMLEV_OPS_ARG_TYPE_ERROR, DAMLEV_OPS_ARG_TYPE_ERROR_LEN);
+        return 1;
+    }
+
+    // Attempt to allocate persistent data.
+    initid->ptr = (char *)new(std::nothrow) OpsData();
+    if (initid->ptr == nullptr) {
+        strncpy(message, DAMLEV_OPS_MEM_ERROR, DAMLEV_OPS_MEM_ERROR_LEN);
+        return 1;
+    }
+
+    // Here the lengths are the longest the arguments can be. A run of r edits takes at
+    // most 3r characters with its separator, so the script is never longer than three
+    // characters per character of either string.
+    initid->max_length = 3 * (args->lengths[0] + args->lengths[1]);
+    // damlev_ops does not return null.
+    initid->maybe_null = 0;
+    return 0;
+}
+
+void damlev_ops_deinit(UDF_INIT *initid) {
+    delete (OpsData *)initid->ptr;
+}
+
+char *damlev_ops(UDF_INIT *initid, UDF_ARGS *args, UNUSED char *result, unsigned long *length,
+                 UNUSED char *is_null, UNUSED char *error) {
+    OpsData &data = *(OpsData *)initid->ptr;
+    std::string_view subject{args->args[0] ? args->args[0] : "",
+                             args->args[0] ? args->lengths[0] : 0};
+    std::string_view query{args->args[1] ? args->args[1] : "",
+                           args->args[1] ? args->lengths[1] : 0};
+
+    // The common prefix and suffix are kept as they are.
+    auto [subject_begin, query_begin] =
+            std::mismatch(subject.begin(), subject.end(), query.begin(), query.end());
+    const auto start_offset = (size_t)std::distance(subject.begin(), subject_begin);
+    subject.remove_prefix(start_offset);
+    query.remove_prefix(start_offset);
+    auto [subject_end, query_end] =
+            std::mismatch(subject.rbegin(), subject.rend(), query.rbegin(), query.rend());
+    const auto end_offset = (size_t)std::distance(subject.rbegin(), subject_end);
+    subject.remove_suffix(end_offset);
+    query.remove_suffix(end_offset);
+
+#ifdef PRINT_DEBUG
+    std::cout << "trimmed subject= " << subject << std::endl;
+    std::cout << "trimmed query= " << query << std::endl;
+#endif
+
+    data.edits.clear();
+    data.edits.insert(data.edits.end(), start_offset, OSA_EDIT_MATCH);
+    osa_script(subject, query, data.buffer, data.edits);
+    data.edits.insert(data.edits.end(), end_offset, OSA_EDIT_MATCH);
+
+    osa_script_runs(data.edits, data.script);
+    *length = data.script.length();
+    return data.script.data();
+}
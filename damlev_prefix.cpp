@@ -0,0 +1,159 @@
+/*
+    Prefix Edit Distance UDF for MySQL.
+
+    <hr>
+    `DAMLEV_PREFIX()` computes the smallest Damarau Levenshtein edit distance between
+    what a user has typed so far and any prefix of a candidate, for type-ahead search
+    where "levensh" should match "Levenshtein" with a distance of 0.
+
+    Syntax:
+
+        DAMLEV_PREFIX(Candidate, Typed, PosInt);
+
+    `Candidate`: A string constant or column to be completed.
+    `Typed`:     A string constant or column holding the partial input.
+    `PosInt`:    A positive integer. If no prefix of `Candidate` is within `PosInt` of
+                 `Typed`, `DAMLEV_PREFIX()` returns the length of `Typed`, which is
+                 always an upper bound. Make `PosInt` as small as you can: only the
+                 first length(`Typed`) + `PosInt` characters of `Candidate` are read.
+
+    Returns: Either an integer equal to the smallest edit distance between `Typed`
+    and a prefix of `Candidate`, or the length of `Typed`.
+
+    Example Usage:
+
+        SELECT Name FROM CUSTOMERS
+            WHERE DAMLEV_PREFIX(Name, "Vladmir Io", 2) <= 2;
+
+    The above will return every `Name` that starts with something within two typos
+    of "Vladmir Io", such as "Vladimir Iosifovich Levenshtein".
+
+    <hr>
+
+    Every prefix of the candidate ends on a different column of the same matrix, so a
+    single banded pass finds the best one (see osa_prefix in osa.h).
+
+    Released under the MIT license.
+
+    The MIT License
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to
+    deal in the Software without restriction, including without limitation the
+    rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+    sell copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in
+    all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+    IN THE SOFTWARE.
+*/
+#include "common.h"
+#include "osa.h"
+#include "osa_simd.h"
+//#define PRINT_DEBUG
+#ifdef PRINT_DEBUG
+#include <iostream>
+#endif
+
+// Error messages.
+// MySQL error messages can be a maximum of MYSQL_ERRMSG_SIZE bytes long. In
+// version 8.0, MYSQL_ERRMSG_SIZE == 512. However, the example says to "try to
+// keep the error message less than 80 bytes long!" Rules were meant to be
+// broken.
+constexpr const char
+        DAMLEV_PREFIX_ARG_NUM_ERROR[] = "Wrong number of arguments. DAMLEV_PREFIX() requires three arguments:\n"
+                                        "\t1. A string to complete.\n"
+                                        "\t2. The string typed so far.\n"
+                                        "\t3. A maximum distance (0 <= int).";
+constexpr const auto DAMLEV_PREFIX_ARG_NUM_ERROR_LEN = std::size(DAMLEV_PREFIX_ARG_NUM_ERROR) + 1;
+constexpr const char DAMLEV_PREFIX_MEM_ERROR[] = "Failed to allocate memory for DAMLEV_PREFIX"
+                                                 " function.";
+constexpr const auto DAMLEV_PREFIX_MEM_ERROR_LEN = std::size(DAMLEV_PREFIX_MEM_ERROR) + 1;
+constexpr const char
+        DAMLEV_PREFIX_ARG_TYPE_ERROR[] = "Arguments have wrong type. DAMLEV_PREFIX() requires three arguments:\n"
+                                         "\t1. A string to complete.\n"
+                                         "\t2. The string typed so far.\n"
+                                         "\t3. A maximum distance (0 <= int).";
+constexpr const auto DAMLEV_PREFIX_ARG_TYPE_ERROR_LEN = std::size(DAMLEV_PREFIX_ARG_TYPE_ERROR) + 1;
+
+// Use a "C" calling convention.
+extern "C" {
+bool damlev_prefix_init(UDF_INIT *initid, UDF_ARGS *args, char *message);
+long long damlev_prefix(UDF_INIT *initid, UDF_ARGS *args, char *is_null, char *error);
+void damlev_prefix_deinit(UDF_INIT *initid);
+}
+
+bool damlev_prefix_init(UDF_INIT *initid, UDF_ARGS *args, char *message) {
+    // We require 3 arguments:
+    if (args->arg_count != 3) {
+        strncpy(message, DAMLEV_PREFIX_ARG_NUM_ERROR, DAMLEV_PREFIX_ARG_NUM_ERROR_LEN);
+        return 1;
+    }
+    // The arguments needs to be of the right type.
+    else if (args->arg_type[0] != STRING_RESULT || args->arg_type[1] != STRING_RESULT ||
+             args->arg_type[2] != INT_RESULT) {
+        strncpy(message, DAMLEV_PREFIX_ARG_TYPE_ERROR, DAMLEV_PREFIX_ARG_TYPE_ERROR_LEN);
+        return 1;
+    }
+
+    // Attempt to allocate a buffer.
+    initid->ptr = (char *)new(std::nothrow) OsaBuffer();
+    if (initid->ptr == nullptr) {
+        strncpy(message, DAMLEV_PREFIX_MEM_ERROR, DAMLEV_PREFIX_MEM_ERROR_LEN);
+        return 1;
+    }
+
+    // damlev_prefix does not return null.
+    initid->maybe_null = 0;
+    return 0;
+}
+
+void damlev_prefix_deinit(UDF_INIT *initid) {
+    delete (OsaBuffer *)initid->ptr;
+}
+
+long long damlev_prefix(UDF_INIT *initid, UDF_ARGS *args, UNUSED char *is_null,
+                        UNUSED char *error) {
+    if (args->args[1] == nullptr || args->lengths[1] == 0) {
+        // Nothing typed yet matches the empty prefix of anything.
+        return 0;
+    }
+    if (args->args[0] == nullptr || args->lengths[0] == 0) {
+        // Only the empty prefix, so every typed character has to go.
+        return (long long)args->lengths[1];
+    }
+    const long long max = std::max(0ll, *((long long *)args->args[2]));
+
+    OsaBuffer &buffer = *(OsaBuffer *)initid->ptr;
+    std::string_view candidate{args->args[0], args->lengths[0]};
+    std::string_view typed{args->args[1], args->lengths[1]};
+
+    // Skip what the user got right. A prefix of the candidate that stops inside it
+    // can never beat the one that covers all of it.
+    const size_t start_offset = osa_common_prefix(candidate.data(), typed.data(),
+                                                  std::min(candidate.length(), typed.length()));
+    if (typed.length() == start_offset) {
+        return 0;
+    }
+    candidate.remove_prefix(start_offset);
+    typed.remove_prefix(start_offset);
+
+#ifdef PRINT_DEBUG
+    std::cout << "trimmed candidate= " << candidate << std::endl;
+    std::cout << "trimmed typed= " << typed << std::endl;
+#endif
+
+    const long long distance = osa_prefix(candidate, typed, max, buffer);
+    if (distance > max) {
+        return (long long)args->lengths[1];
+    }
+    return distance;
+}
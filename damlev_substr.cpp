@@ -0,0 +1,197 @@
+/*
+    Approximate Substring Search UDF for MySQL.
+
+    <hr>
+    `DAMLEV_SUBSTR()` computes the smallest Damarau Levenshtein edit distance between
+    a pattern and any substring of a text, for finding misspelled names inside longer
+    free text without cutting the text into slices in SQL.
+
+    Syntax:
+
+        DAMLEV_SUBSTR(Text, Pattern, PosInt);
+
+    `Text`:     A string constant or column to search in.
+    `Pattern`:  A string constant or column to search for. If it is the same on every
+                row, it is only compiled once per statement.
+    `PosInt`:   A positive integer. If no substring of `Text` is within `PosInt` of
+                `Pattern`, `DAMLEV_SUBSTR()` returns the length of `Pattern`, which is
+                always an upper bound. Make `PosInt` as small as you can: the search
+                only looks at as much of a long pattern as can still be within it.
+
+    Returns: Either an integer equal to the smallest edit distance between `Pattern`
+    and a substring of `Text`, or the length of `Pattern`.
+
+    Example Usage:
+
+        SELECT Description FROM PRODUCTS
+            WHERE DAMLEV_SUBSTR(Description, "Levenshtein", 2) <= 2;
+
+    The above will return every `Description` that contains "Levenshtein" with at
+    most two typos.
+
+    <hr>
+
+    The search runs the bit-parallel optimal string alignment recurrence in search
+    mode (see bitparallel.h), so its cost is linear in the length of `Text`.
+
+    Released under the MIT license.
+
+    The MIT License
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to
+    deal in the Software without restriction, including without limitation the
+    rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+    sell copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in
+    all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+    IN THE SOFTWARE.
+*/
+#include "common.h"
+#include "bitparallel.h"
+//#define PRINT_DEBUG
+#ifdef PRINT_DEBUG
+#include <iostream>
+#endif
+
+// Error messages.
+// MySQL error messages can be a maximum of MYSQL_ERRMSG_SIZE bytes long. In
+// version 8.0, MYSQL_ERRMSG_SIZE == 512. However, the example says to "try to
+// keep the error message less than 80 bytes long!" Rules were meant to be
+// broken.
+constexpr const char
+        DAMLEV_SUBSTR_ARG_NUM_ERROR[] = "Wrong number of arguments. DAMLEV_SUBSTR() requires three arguments:\n"
+                                        "\t1. A string to search in.\n"
+                                        "\t2. A string to search for.\n"
+                                        "\t3. A maximum distance (0 <= int).";
+constexpr const auto DAMLEV_SUBSTR_ARG_NUM_ERROR_LEN = std::size(DAMLEV_SUBSTR_ARG_NUM_ERROR) + 1;
+constexpr const char DAMLEV_SUBSTR_MEM_ERROR[] = "Failed to allocate memory for DAMLEV_SUBSTR"
+                                                 " function.";
+constexpr const auto DAMLEV_SUBSTR_MEM_ERROR_LEN = std::size(DAMLEV_SUBSTR_MEM_ERROR) + 1;
+constexpr const char
+        DAMLEV_SUBSTR_ARG_TYPE_ERROR[] = "Arguments have wrong type. DAMLEV_SUBSTR() requires three arguments:\n"
+                                         "\t1. A string to search in.\n"
+                                         "\t2. A string to search for.\n"
+                                         "\t3. A maximum distance (0 <= int).";
+constexpr const auto DAMLEV_SUBSTR_ARG_TYPE_ERROR_LEN = std::size(DAMLEV_SUBSTR_ARG_TYPE_ERROR) + 1;
+
+// Use a "C" calling convention.
+extern "C" {
+bool damlev_substr_init(UDF_INIT *initid, UDF_ARGS *args, char *message);
+long long damlev_substr(UDF_INIT *initid, UDF_ARGS *args, char *is_null, char *error);
+void damlev_substr_deinit(UDF_INIT *initid);
+}
+
+struct SubstrData {
+    // Match masks of `pattern`, with a stride of `arena.words`.
+    BitparArena arena;
+    // The pattern the masks were built for. Rows with the same pattern reuse them.
+    char *pattern;
+    size_t pattern_len;
+    size_t pattern_capacity;
+};
+
+bool damlev_substr_init(UDF_INIT *initid, UDF_ARGS *args, char *message) {
+    // We require 3 arguments:
+    if (args->arg_count != 3) {
+        strncpy(message, DAMLEV_SUBSTR_ARG_NUM_ERROR, DAMLEV_SUBSTR_ARG_NUM_ERROR_LEN);
+        return 1;
+    }
+    // The arguments needs to be of the right type.
+    else if (args->arg_type[0] != STRING_RESULT || args->arg_type[1] != STRING_RESULT ||
+             args->arg_type[2] != INT_RESULT) {
+        strncpy(message, DAMLEV_SUBSTR_ARG_TYPE_ERROR, DAMLEV_SUBSTR_ARG_TYPE_ERROR_LEN);
+        return 1;
+    }
+
+    // One block of masks covers most patterns; longer ones grow the arena on the
+    // first row.
+    SubstrData *data = new(std::nothrow) SubstrData();
+    if (nullptr == data || !bitpar_arena_reserve(data->arena, 1)) {
+        delete data;
+        strncpy(message, DAMLEV_SUBSTR_MEM_ERROR, DAMLEV_SUBSTR_MEM_ERROR_LEN);
+        return 1;
+    }
+    data->pattern = nullptr;
+    data->pattern_len = 0;
+    data->pattern_capacity = 0;
+    initid->ptr = (char *)data;
+
+    // damlev_substr does not return null.
+    initid->maybe_null = 0;
+    return 0;
+}
+
+void damlev_substr_deinit(UDF_INIT *initid) {
+    SubstrData *data = (SubstrData *)initid->ptr;
+    bitpar_arena_free(data->arena);
+    delete[] data->pattern;
+    delete data;
+}
+
+long long damlev_substr(UDF_INIT *initid, UDF_ARGS *args, UNUSED char *is_null, char *error) {
+    if (args->args[1] == nullptr || args->lengths[1] == 0) {
+        // The empty pattern is in every text.
+        return 0;
+    }
+    if (args->args[0] == nullptr || args->lengths[0] == 0) {
+        // Nothing to match, so every character of the pattern has to go.
+        return (long long)args->lengths[1];
+    }
+    const long long max = std::max(0ll, *((long long *)args->args[2]));
+
+    SubstrData &data = *(SubstrData *)initid->ptr;
+    std::string_view text{args->args[0], args->lengths[0]};
+    std::string_view pattern{args->args[1], args->lengths[1]};
+
+    // Compile the pattern, unless it is the one from the previous row.
+    if (pattern != std::string_view{data.pattern, data.pattern_len}) {
+        bitpar_arena_clear(data.arena, {data.pattern, data.pattern_len});
+        data.pattern_len = 0;
+        const size_t words = (pattern.length() + BITPAR_WORD_BITS - 1) / BITPAR_WORD_BITS;
+        if (!bitpar_arena_reserve(data.arena, words)) {
+            *error = 1;
+            return 0;
+        }
+        if (data.pattern_capacity < pattern.length()) {
+            delete[] data.pattern;
+            data.pattern = new(std::nothrow) char[pattern.length()];
+            if (nullptr == data.pattern) {
+                data.pattern_capacity = 0;
+                *error = 1;
+                return 0;
+            }
+            data.pattern_capacity = pattern.length();
+        }
+        memcpy(data.pattern, pattern.data(), pattern.length());
+        data.pattern_len = pattern.length();
+        bitpar_arena_set(data.arena, pattern);
+    }
+
+#ifdef PRINT_DEBUG
+    std::cout << "text= " << text << std::endl;
+    std::cout << "pattern= " << pattern << std::endl;
+#endif
+
+    long long distance;
+    if (pattern.length() <= BITPAR_WORD_BITS) {
+        distance = bitpar_osa_search_word(data.arena.peq, data.arena.words, pattern.length(),
+                                          text);
+    } else {
+        distance = bitpar_osa_search_blocks(data.arena.peq, data.arena.words, pattern.length(),
+                                            text, max, data.arena.blocks);
+    }
+    if (distance > max) {
+        return (long long)pattern.length();
+    }
+    return distance;
+}
@@ -13,7 +13,7 @@
 
     Syntax:
 
-        DAMLEVCONST(String1, ConstString, PosInt);
+        DAMLEVCONST(String1, ConstString, PosInt[, Flags]);
 
     `String1`:  A string constant or column.
     `ConstString`:  A string constant to be compared to `String1`.
@@ -23,6 +23,10 @@
                 small as you can to improve speed and efficiency. For example,
                 if you put `WHERE DAMLEVCONST(...) < k` in a `WHERE`-clause, make
                 `PosInt` be `k`.
+    `Flags`:    An optional integer constant, the sum of any of: 1 to compare UTF-8
+                code points instead of bytes, so that "é" is one character; 2 to
+                ignore case; 4 to ignore accents, so that "é" matches "e" (see
+                fold.h). The constant is only folded once.
 
     Returns: Either an integer equal to the edit distance between `String1` and `String2` or `PosInt`,
     whichever is smaller.
@@ -64,6 +68,12 @@
 */
 
 #include "common.h"
+#include "bitparallel.h"
+#include "osa_filter.h"
+#include "osa_short.h"
+#include "osa_transition.h"
+#include "fold.h"
+#include "utf8.h"
 //#define PRINT_DEBUG
 #ifdef PRINT_DEBUG
 #include <iostream>
@@ -74,8 +84,7 @@
     // 640k should be good enough for anybody.
     #define DAMLEVCONST_BUFFER_SIZE 512ull
 #endif
-constexpr long long DAMLEVCONST_MAX_EDIT_DIST = std::max(0ull,
-        std::min(16384ull, DAMLEVCONST_BUFFER_SIZE));
+constexpr long long DAMLEVCONST_MAX_EDIT_DIST = DAMLEVCONST_BUFFER_SIZE;
 
 // Error messages.
 // MySQL error messages can be a maximum of MYSQL_ERRMSG_SIZE bytes long. In
@@ -83,19 +92,21 @@ constexpr long long DAMLEVCONST_MAX_EDIT_DIST = std::max(0ull,
 // keep the error message less than 80 bytes long!" Rules were meant to be
 // broken.
 constexpr const char
-        DAMLEVCONST_ARG_NUM_ERROR[] = "Wrong number of arguments. DAMLEVCONST() requires three arguments:\n"
+        DAMLEVCONST_ARG_NUM_ERROR[] = "Wrong number of arguments. DAMLEVCONST() requires three or four arguments:\n"
                                  "\t1. A string\n"
                                  "\t2. A string\n"
-                                 "\t3. A maximum distance (0 <= int < ${DAMLEVCONST_MAX_EDIT_DIST}).";
+                                 "\t3. A maximum distance (0 <= int < ${DAMLEVCONST_MAX_EDIT_DIST}).\n"
+                                 "\t4. Optionally, flags (1 for UTF-8, 2 to fold case, 4 to fold accents).";
 constexpr const auto DAMLEVCONST_ARG_NUM_ERROR_LEN = std::size(DAMLEVCONST_ARG_NUM_ERROR) + 1;
 constexpr const char DAMLEVCONST_MEM_ERROR[] = "Failed to allocate memory for DAMLEVCONST"
                                           " function.";
 constexpr const auto DAMLEVCONST_MEM_ERROR_LEN = std::size(DAMLEVCONST_MEM_ERROR) + 1;
 constexpr const char
-        DAMLEVCONST_ARG_TYPE_ERROR[] = "Arguments have wrong type. DAMLEVCONST() requires three arguments:\n"
+        DAMLEVCONST_ARG_TYPE_ERROR[] = "Arguments have wrong type. DAMLEVCONST() requires three or four arguments:\n"
                                      "\t1. A string\n"
                                      "\t2. A string\n"
-                                     "\t3. A maximum distance (0 <= int < ${DAMLEVCONST_MAX_EDIT_DIST}).";
+                                     "\t3. A maximum distance (0 <= int < ${DAMLEVCONST_MAX_EDIT_DIST}).\n"
+                                     "\t4. Optionally, flags (1 for UTF-8, 2 to fold case, 4 to fold accents).";
 constexpr const auto DAMLEVCONST_ARG_TYPE_ERROR_LEN = std::size(DAMLEVCONST_ARG_TYPE_ERROR) + 1;
 
 // Use a "C" calling convention.
@@ -111,13 +122,28 @@ struct PersistentData {
     long long max;
     size_t const_len;
     char * const_string;
-    // A buffer we only need to allocate once.
-    std::vector<size_t> *buffer;
+    // Match masks of the constant for the bit-parallel kernels, `peq_words` words per
+    // character.
+    uint64_t *peq;
+    size_t peq_words;
+    // Per-block state for constants longer than one word.
+    BitparBlock *blocks;
+    // Lower bounds against the constant, to turn most rows away before any kernel.
+    OsaFilter *filter;
+    // Furthest rows per diagonal, for long strings with a small limit.
+    std::vector<long long> *furthest;
+    long long flags;
+    // The folded constant and rows, if the flags ask for any folding.
+    FoldBuffer *fold;
+    // In UTF-8 mode, the code points of the constant and the rewritten rows. If the
+    // constant has too many different code points to rewrite, it is `wide`.
+    Utf8Buffer *utf8;
+    bool wide;
 };
 
 bool damlevconst_init(UDF_INIT *initid, UDF_ARGS *args, char *message) {
-    // We require 3 arguments:
-    if (args->arg_count != 3) {
+    // We require 3 or 4 arguments:
+    if (args->arg_count != 3 && args->arg_count != 4) {
         strncpy(message, DAMLEVCONST_ARG_NUM_ERROR, DAMLEVCONST_ARG_NUM_ERROR_LEN);
         return 1;
     }
@@ -127,6 +153,11 @@ bool damlevconst_init(UDF_INIT *initid, UDF_ARGS *args, char *message) {
         strncpy(message, DAMLEVCONST_ARG_TYPE_ERROR, DAMLEVCONST_ARG_TYPE_ERROR_LEN);
         return 1;
     }
+    long long flags;
+    if (!damlev_flags(args, 3, flags)) {
+        strncpy(message, DAMLEV_FLAGS_ERROR, DAMLEV_FLAGS_ERROR_LEN);
+        return 1;
+    }
 
     // Attempt to allocate persistent data.
     PersistentData *data = new PersistentData();
@@ -138,14 +169,35 @@ bool damlevconst_init(UDF_INIT *initid, UDF_ARGS *args, char *message) {
     // Initialize persistent data.
     initid->ptr = (char *)data;
     data->max = DAMLEVCONST_MAX_EDIT_DIST;
-    data->buffer = new std::vector<size_t>(data->max);
-    data->const_string = new(std::nothrow) char[DAMLEVCONST_MAX_EDIT_DIST];
-    if (nullptr == data->const_string) {
+    // Initialized on first call to damlevconst.
+    data->const_len = 0;
+    data->const_string = nullptr;
+    data->peq = nullptr;
+    data->peq_words = 0;
+    data->blocks = nullptr;
+    data->furthest = new(std::nothrow) std::vector<long long>();
+    data->filter = new(std::nothrow) OsaFilter();
+    data->flags = flags;
+    data->fold = nullptr;
+    data->utf8 = nullptr;
+    data->wide = false;
+    const bool folding = 0 != (flags & (DAMLEV_FOLD_CASE | DAMLEV_FOLD_ACCENTS));
+    if (folding) {
+        data->fold = new(std::nothrow) FoldBuffer();
+    }
+    if (flags & DAMLEV_UTF8) {
+        data->utf8 = new(std::nothrow) Utf8Buffer();
+    }
+    if (nullptr == data->furthest || nullptr == data->filter || (folding && nullptr == data->fold) ||
+        ((flags & DAMLEV_UTF8) && nullptr == data->utf8)) {
+        delete data->furthest;
+        delete data->filter;
+        delete data->fold;
+        delete data->utf8;
+        delete data;
         strncpy(message, DAMLEVCONST_MEM_ERROR, DAMLEVCONST_MEM_ERROR_LEN);
         return 1;
     }
-    // Initialized on first call to damlevconst.
-    data->const_len = 0;
 
     // damlevconst does not return null.
     initid->maybe_null = 0;
@@ -158,13 +210,21 @@ void damlevconst_deinit(UDF_INIT *initid) {
         delete[] data.const_string;
         data.const_string = nullptr;
     }
-    if(nullptr != data.buffer){
-        delete data.buffer;
-        data.buffer = nullptr;
+    if(nullptr != data.peq){
+        delete[] data.peq;
+        data.peq = nullptr;
+    }
+    if(nullptr != data.blocks){
+        delete[] data.blocks;
+        data.blocks = nullptr;
     }
-    delete[] initid->ptr;
+    delete data.furthest;
+    delete data.filter;
+    delete data.fold;
+    delete data.utf8;
+    delete (PersistentData *)initid->ptr;
 }
-int damlevconst(UDF_INIT *initid, UDF_ARGS *args, UNUSED char *is_null, UNUSED char *error) {
+int damlevconst(UDF_INIT *initid, UDF_ARGS *args, UNUSED char *is_null, char *error) {
 
     // Retrieve the arguments, setting maximum edit distance and the strings accordingly.
     if ((long long *) args->args[2] == 0) {
@@ -176,10 +236,6 @@ int damlevconst(UDF_INIT *initid, UDF_ARGS *args, UNUSED char *is_null, UNUSED c
     // Retrieve the persistent data.
     PersistentData &data = *(PersistentData *) initid->ptr;
     long long &max = data.max;
-    // Retrieve buffer.
-    std::vector<size_t> &buffer = *data.buffer; // Initialized later.
-
-
 
     // For purposes of the algorithm, set max to the smallest distance seen so far.
     max = std::min(*((long long *) args->args[2]), max);
@@ -188,9 +244,17 @@ int damlevconst(UDF_INIT *initid, UDF_ARGS *args, UNUSED char *is_null, UNUSED c
         args->lengths[1] == 0) {
         // Either one of the strings doesn't exist, or one of the strings has
         // length zero. In either case
-        return (long long) std::max(args->lengths[0], args->lengths[1]);
+        std::string_view subject = damlev_string(args, 0);
+        std::string_view query = damlev_string(args, 1);
+        if (nullptr != data.fold) {
+            subject = fold_string(subject, data.flags, data.fold->a);
+            query = fold_string(query, data.flags, data.fold->b);
+        }
+        if (data.flags & DAMLEV_UTF8) {
+            return (long long)std::max(utf8_length(subject), utf8_length(query));
+        }
+        return (long long) std::max(subject.length(), query.length());
     }
-    int max_string_length = static_cast<double>(std::max(args->lengths[0], args->lengths[1]));
 
 
 #ifdef PRINT_DEBUG
@@ -208,21 +272,92 @@ int damlevconst(UDF_INIT *initid, UDF_ARGS *args, UNUSED char *is_null, UNUSED c
 
     // Check if initialization of persistent data is required. We cannot do this in
     // damlevconst_init, because we do not know what the constant is yet in damlevconst_init.
-    if (0 == data.const_len) {
-        // Only done once.
-        data.const_len = args->lengths[1];
-        strncpy(data.const_string, args->args[1], data.const_len);
+    if (nullptr == data.const_string) {
+        // Only done once, folding included.
+        std::string_view constant{args->args[1], args->lengths[1]};
+        if (nullptr != data.fold) {
+            constant = fold_string(constant, data.flags, data.fold->b);
+        }
+        const size_t const_len = constant.length();
+        data.peq_words = (const_len + BITPAR_WORD_BITS - 1) / BITPAR_WORD_BITS;
+        data.const_string = new(std::nothrow) char[const_len + 1];
+        data.peq = new(std::nothrow) uint64_t[BITPAR_ALPHABET_SIZE * data.peq_words];
+        data.blocks = new(std::nothrow) BitparBlock[data.peq_words];
+        if (nullptr == data.const_string || nullptr == data.peq || nullptr == data.blocks) {
+            // Leave it all to be tried again, since a constant string marks it as done.
+            delete[] data.const_string;
+            delete[] data.peq;
+            delete[] data.blocks;
+            data.const_string = nullptr;
+            data.peq = nullptr;
+            data.blocks = nullptr;
+            *error = 1;
+            return 0;
+        }
+        data.const_len = const_len;
+        memcpy(data.const_string, constant.data(), data.const_len);
         // Null terminate the string.
         data.const_string[data.const_len] = '\0';
 
+        // In UTF-8 mode, compile the constant's code points instead, one byte each.
+        // Every row is rewritten with the same numbering.
+        if (data.flags & DAMLEV_UTF8) {
+            Utf8Buffer &utf8 = *data.utf8;
+            utf8_alphabet_clear(utf8.alphabet);
+            if (utf8_compile(utf8.alphabet, constant, utf8.b)) {
+                data.const_len = utf8.b.length();
+                memcpy(data.const_string, utf8.b.data(), data.const_len);
+                data.const_string[data.const_len] = '\0';
+            } else {
+                utf8_decode(constant, utf8.wide_b);
+                data.wide = true;
+            }
+        }
+
+        // Compile the constant into match masks, so that each row only costs a few word
+        // operations per character instead of a full DP matrix.
+        bitpar_build_peq_blocks({data.const_string, data.const_len}, data.peq, data.peq_words);
+        osa_filter_compile(*data.filter, {data.const_string, data.const_len});
     }
 
     std::string_view query{data.const_string, data.const_len};
+    if (nullptr != data.fold) {
+        subject = fold_string(subject, data.flags, data.fold->a);
+    }
 
-    // Skip any common prefix.
-    auto [subject_begin, query_begin] =
-            std::mismatch(subject.begin(), subject.end(), query.begin(), query.end());
-    auto start_offset = (size_t) std::distance(subject.begin(), subject_begin);
+    if (data.flags & DAMLEV_UTF8) {
+        Utf8Buffer &utf8 = *data.utf8;
+        if (data.wide) {
+            // Too many different code points for bytes: compare them as they are.
+            utf8_decode(subject, utf8.wide_a);
+            std::u32string_view wide_subject = utf8.wide_a;
+            std::u32string_view wide_query = utf8.wide_b;
+            const long long distance = osa_banded(wide_subject, wide_query, max, utf8.wide_rows);
+            if (distance > max) {
+                return (long long)std::max(wide_subject.length(), wide_query.length());
+            }
+            return distance;
+        }
+        // ASCII bytes already mean the same in the rewrite.
+        if (!osa_is_ascii(subject.data(), subject.length())) {
+            utf8_transcode(utf8.alphabet, subject, utf8.a);
+            subject = utf8.a;
+        }
+    }
+    // Lengths of the strings as they are compared, folded and in UTF-8 one per code point.
+    const int max_string_length = (int)std::max(subject.length(), query.length());
+
+    // Most rows of a scan are nowhere near the constant, and cheap lower bounds show
+    // it without running a kernel.
+    if (osa_filter_rejects(*data.filter, subject, max)) {
+        return max_string_length;
+    }
+
+    // Skip any common prefix, a vector at a time since long documents can share a lot.
+    auto start_offset = osa_common_prefix(subject.data(), query.data(),
+                                          std::min(subject.length(), query.length()));
+    auto subject_begin = subject.begin() + start_offset;
+    auto query_begin = query.begin() + start_offset;
 
     // If one of the strings is a prefix of the other, done.
     if (subject.length() == start_offset) {
@@ -237,6 +372,13 @@ int damlevconst(UDF_INIT *initid, UDF_ARGS *args, UNUSED char *is_null, UNUSED c
         return (size_t) (subject.length() - start_offset);
     }
 
+    // Codes and names fit in a register, and a kernel built for the exact length
+    // beats trimming them and shifting the compiled masks.
+    if (subject.length() <= OSA_SHORT_MAX_LENGTH && query.length() <= OSA_SHORT_MAX_LENGTH) {
+        const long long distance = osa_short_distance(subject, query);
+        return distance > max ? max_string_length : distance;
+    }
+
     // Skip any common suffix.
     auto [subject_end, query_end] = std::mismatch(
             subject.rbegin(), static_cast<decltype(subject.rend())>(subject_begin),
@@ -245,60 +387,45 @@ int damlevconst(UDF_INIT *initid, UDF_ARGS *args, UNUSED char *is_null, UNUSED c
                                (size_t) (subject.size() - start_offset));
 
     // Take the different part.
+    size_t query_offset = 0;
     if (start_offset > 2 && end_offset > 2) {
         subject = subject.substr(start_offset, subject.size() - end_offset - start_offset);
         query = query.substr(start_offset, query.size() - end_offset - start_offset);
+        query_offset = start_offset;
     }
 
-    int trimmed_max = std::max(int(query.length()), int(subject.length()));
 #ifdef PRINT_DEBUG
-    std::cout << "trimmed max length:" <<trimmed_max<<std::endl;
     std::cout << "trimmed subject= " <<subject <<std::endl;
     std::cout <<"trimmed constant query= " <<query<<std::endl;
 #endif
 
-    // Make "subject" the smaller one
-    if (query.length() < subject.length()) {
-        std::swap(subject, query);
-    }
-
-    int n = subject.size();
-    int m = query.size();
-
-    // Resize buffer to simulate a 2D matrix
-    buffer.resize((n + 1) * (m + 1));
-
-    // Function to access the 2D matrix simulated in a 1D vector
-    auto idx = [m](int i, int j) { return i * (m + 1) + j; };
-
-    // Initialize first row and column
-    for (int i = 0; i <= n; i++) {
-        buffer[idx(i, 0)] = i;
+    // A cheap alignment bounds the distance, so the band never has to be wider than
+    // its cost, and if that is just the length difference it is the distance.
+    const long long length_difference = std::abs((long long)subject.length() -
+                                                 (long long)query.length());
+    const long long bound = osa_upper_bound(subject, query);
+    if (bound <= length_difference) {
+        return bound > max ? max_string_length : bound;
     }
-    for (int j = 0; j <= m; j++) {
-        buffer[idx(0, j)] = j;
+    const long long k = std::min(max, bound);
+
+    // The trimmed constant starts `query_offset` characters into the compiled one,
+    // which the kernels handle by shifting the masks.
+    long long distance;
+    if ((long long)std::max(subject.length(), query.length()) >= OSA_TRANSITION_MIN_RATIO * k) {
+        // Long strings with a small limit: following each diagonal from mismatch to
+        // mismatch touches far fewer characters than even the bit-parallel kernels.
+        distance = osa_transition(subject, query, k, *data.furthest);
+    } else if (1 == data.peq_words) {
+        distance = bitpar_osa_word(data.peq, query_offset, query.length(), subject, k);
+    } else {
+        // Only the blocks of the constant that can still be within `k` of `subject`
+        // are evaluated.
+        distance = bitpar_osa_blocks(data.peq, data.peq_words, query_offset, query.length(),
+                                     subject, k, data.blocks);
     }
-
-    for (int i = 1; i <= n; i++) {
-        size_t column_min = trimmed_max + 1;
-        for (int j = 1; j <= m; j++) {
-            int cost = (subject[i - 1] == query[j - 1]) ? 0 : 1;
-
-            buffer[idx(i, j)] = std::min({ buffer[idx(i - 1, j)] + 1,
-                                           buffer[idx(i, j - 1)] + 1,
-                                           buffer[idx(i - 1, j - 1)] + cost });
-
-            if (i > 1 && j > 1 && subject[i - 1] == query[j - 2] && subject[i - 2] == query[j - 1]) {
-                buffer[idx(i, j)] = std::min(buffer[idx(i, j)], buffer[idx(i - 2, j - 2)] + cost);
-            }
-
-            column_min = std::min(column_min, buffer[idx(i, j)]);
-        }
-
-        if (column_min > max) {
-            return max_string_length;
-        }
+    if (distance > max) {
+        return max_string_length;
     }
-    data.buffer->resize(DAMLEVCONST_MAX_EDIT_DIST);
-    return buffer[idx(n, m)];
+    return distance;
 }
@@ -0,0 +1,158 @@
+/*
+    Unrestricted Damerau–Levenshtein Edit Distance UDF for MySQL.
+
+    <hr>
+    `DAMLEVFULL()` computes the unrestricted Damarau Levenshtein edit distance between
+    two strings. The other functions in this library compute the optimal string
+    alignment distance, which never edits a substring twice and so is not a metric:
+    DAMLEV("ca", "abc") is 3, while DAMLEVFULL("ca", "abc") is 2. Use this one when
+    the triangle inequality matters, for example to prune a metric index.
+
+    Syntax:
+
+        DAMLEVFULL(String1, String2);
+
+    `String1`:  A string constant or column.
+    `String2`:  A string constant or column to be compared to `String1`.
+
+    Returns: An integer equal to the edit distance between `String1` and `String2`.
+
+    Example Usage:
+
+        SELECT Name, DAMLEVFULL(Name, "Vladimir Iosifovich Levenshtein") AS
+            EditDist FROM CUSTOMERS WHERE DAMLEVFULL(Name, "Vladimir Iosifovich Levenshtein") <= 6;
+
+    The above will return all rows `(Name, EditDist)` from the `CUSTOMERS` table
+    where `Name` has edit distance within 6 of "Vladimir Iosifovich Levenshtein".
+
+    <hr>
+
+    Released under the MIT license.
+
+    The MIT License
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to
+    deal in the Software without restriction, including without limitation the
+    rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+    sell copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in
+    all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+    IN THE SOFTWARE.
+*/
+#include "common.h"
+#include "damerau.h"
+//#define PRINT_DEBUG
+#ifdef PRINT_DEBUG
+#include <iostream>
+#endif
+
+// Error messages.
+// MySQL error messages can be a maximum of MYSQL_ERRMSG_SIZE bytes long. In
+// version 8.0, MYSQL_ERRMSG_SIZE == 512. However, the example says to "try to
+// keep the error message less than 80 bytes long!" Rules were meant to be
+// broken.
+constexpr const char
+        DAMLEVFULL_ARG_NUM_ERROR[] = "Wrong number of arguments. DAMLEVFULL() requires two arguments:\n"
+                                     "\t1. A string.\n"
+                                     "\t2. Another string.";
+constexpr const auto DAMLEVFULL_ARG_NUM_ERROR_LEN = std::size(DAMLEVFULL_ARG_NUM_ERROR) + 1;
+constexpr const char DAMLEVFULL_MEM_ERROR[] = "Failed to allocate memory for DAMLEVFULL"
+                                              " function.";
+constexpr const auto DAMLEVFULL_MEM_ERROR_LEN = std::size(DAMLEVFULL_MEM_ERROR) + 1;
+constexpr const char
+        DAMLEVFULL_ARG_TYPE_ERROR[] = "Arguments have wrong type. DAMLEVFULL() requires two arguments:\n"
+                                      "\t1. A string.\n"
+                                      "\t2. Another string.";
+constexpr const auto DAMLEVFULL_ARG_TYPE_ERROR_LEN = std::size(DAMLEVFULL_ARG_TYPE_ERROR) + 1;
+
+// Use a "C" calling convention.
+extern "C" {
+bool damlevfull_init(UDF_INIT *initid, UDF_ARGS *args, char *message);
+long long damlevfull(UDF_INIT *initid, UDF_ARGS *args, char *is_null, char *error);
+void damlevfull_deinit(UDF_INIT *initid);
+}
+
+bool damlevfull_init(UDF_INIT *initid, UDF_ARGS *args, char *message) {
+    // We require 2 arguments:
+    if (args->arg_count != 2) {
+        strncpy(message, DAMLEVFULL_ARG_NUM_ERROR, DAMLEVFULL_ARG_NUM_ERROR_LEN);
+        return 1;
+    }
+        // The arguments needs to be of the right type.
+    else if (args->arg_type[0] != STRING_RESULT || args->arg_type[1] != STRING_RESULT) {
+        strncpy(message, DAMLEVFULL_ARG_TYPE_ERROR, DAMLEVFULL_ARG_TYPE_ERROR_LEN);
+        return 1;
+    }
+
+    // The rows and the per-character tables live for the whole statement.
+    initid->ptr = (char *)new(std::nothrow) DamerauBuffer();
+    if (initid->ptr == nullptr) {
+        strncpy(message, DAMLEVFULL_MEM_ERROR, DAMLEVFULL_MEM_ERROR_LEN);
+        return 1;
+    }
+
+    // damlevfull does not return null.
+    initid->maybe_null = 0;
+    return 0;
+}
+
+void damlevfull_deinit(UDF_INIT *initid) {
+    delete (DamerauBuffer *)initid->ptr;
+}
+
+long long damlevfull(UDF_INIT *initid, UDF_ARGS *args, UNUSED char *is_null, UNUSED char *error) {
+    if (args->lengths[0] == 0 || args->lengths[1] == 0 || args->args[1] == nullptr
+        || args->args[0] == nullptr) {
+        // Either one of the strings doesn't exist, or one of the strings has
+        // length zero. In either case
+        return (long long) std::max(args->lengths[0], args->lengths[1]);
+    }
+
+    // Retrieve buffer.
+    DamerauBuffer &buffer = *(DamerauBuffer *) initid->ptr;
+
+    // Let's make some string views so we can use the STL.
+    std::string_view subject{args->args[0], args->lengths[0]};
+    std::string_view query{args->args[1], args->lengths[1]};
+
+    // Skip any common prefix.
+    auto [subject_begin, query_begin] =
+            std::mismatch(subject.begin(), subject.end(), query.begin(), query.end());
+    auto start_offset = (size_t) std::distance(subject.begin(), subject_begin);
+
+    // If one of the strings is a prefix of the other, done.
+    if (subject.length() == start_offset) {
+        return (long long) (query.length() - start_offset);
+    } else if (query.length() == start_offset) {
+        return (long long) (subject.length() - start_offset);
+    }
+
+    // Skip any common suffix.
+    auto [subject_end, query_end] = std::mismatch(
+            subject.rbegin(), static_cast<decltype(subject.rend())>(subject_begin),
+            query.rbegin(), static_cast<decltype(query.rend())>(query_begin));
+    auto end_offset = std::min((size_t) std::distance(subject.rbegin(), subject_end),
+                               (size_t) (subject.size() - start_offset));
+
+    // Unlike the optimal string alignment distance, this one is never changed by
+    // trimming, however short the common parts are.
+    subject = subject.substr(start_offset, subject.size() - end_offset - start_offset);
+    query = query.substr(start_offset, query.size() - end_offset - start_offset);
+
+#ifdef PRINT_DEBUG
+    std::cout << "trimmed subject= " << subject << std::endl;
+    std::cout << "trimmed query= " << query << std::endl;
+#endif
+
+    return (long long) damerau_distance(subject, query, buffer);
+}
@@ -13,7 +13,7 @@
 
     Syntax:
 
-        DAMLEVLIM(String1, String2, PosInt);
+        DAMLEVLIM(String1, String2, PosInt[, Flags]);
 
     `String1`:  A string constant or column.
     `String2`:  A string constant or column to be compared to `String1`.
@@ -23,6 +23,9 @@
                 small as you can to improve speed and efficiency. For example,
                 if you put `WHERE DAMLEVLIM(...) < k` in a `WHERE`-clause, make
                 `PosInt` be `k`.
+    `Flags`:    An optional integer constant, the sum of any of: 1 to compare UTF-8
+                code points instead of bytes, so that "é" is one character; 2 to
+                ignore case; 4 to ignore accents, so that "é" matches "e" (see fold.h).
 
     Returns: Either an integer equal to the edit distance between `String1` and `String2` or `k`,
     whichever is smaller.
@@ -63,38 +66,39 @@
     IN THE SOFTWARE.
 */
 #include "common.h"
+#include "osa.h"
+#include "osa_filter.h"
+#include "osa_short.h"
+#include "osa_tiled.h"
+#include "osa_transition.h"
+#include "fold.h"
+#include "utf8.h"
 //#define PRINT_DEBUG
 #ifdef PRINT_DEBUG
 #include <iostream>
 #endif
 
-// Limits
-#ifndef DAMLEVLIM_BUFFER_SIZE
-    // 640k should be good enough for anybody.
-    #define DAMLEVLIM_BUFFER_SIZE 512ull
-#endif
-constexpr long long DAMLEVLIM_MAX_EDIT_DIST = std::max(0ull,
-        std::min(16384ull, DAMLEVLIM_BUFFER_SIZE));
-
 // Error messages.
 // MySQL error messages can be a maximum of MYSQL_ERRMSG_SIZE bytes long. In
 // version 8.0, MYSQL_ERRMSG_SIZE == 512. However, the example says to "try to
 // keep the error message less than 80 bytes long!" Rules were meant to be
 // broken.
 constexpr const char
-        DAMLEVLIM_ARG_NUM_ERROR[] = "Wrong number of arguments. DAMLEVLIM() requires three arguments:\n"
+        DAMLEVLIM_ARG_NUM_ERROR[] = "Wrong number of arguments. DAMLEVLIM() requires three or four arguments:\n"
                                  "\t1. A string\n"
                                  "\t2. A string\n"
-                                 "\t3. A maximum distance (0 <= int < ${DAMLEVLIM_MAX_EDIT_DIST}).";
+                                 "\t3. A maximum distance (0 <= int).\n"
+                                 "\t4. Optionally, flags (1 for UTF-8, 2 to fold case, 4 to fold accents).";
 constexpr const auto DAMLEVLIM_ARG_NUM_ERROR_LEN = std::size(DAMLEVLIM_ARG_NUM_ERROR) + 1;
 constexpr const char DAMLEVLIM_MEM_ERROR[] = "Failed to allocate memory for DAMLEVLIM"
                                           " function.";
 constexpr const auto DAMLEVLIM_MEM_ERROR_LEN = std::size(DAMLEVLIM_MEM_ERROR) + 1;
 constexpr const char
-        DAMLEVLIM_ARG_TYPE_ERROR[] = "Arguments have wrong type. DAMLEVLIM() requires three arguments:\n"
+        DAMLEVLIM_ARG_TYPE_ERROR[] = "Arguments have wrong type. DAMLEVLIM() requires three or four arguments:\n"
                                      "\t1. A string\n"
                                      "\t2. A string\n"
-                                     "\t3. A maximum distance (0 <= int < ${DAMLEVLIM_MAX_EDIT_DIST}).";
+                                     "\t3. A maximum distance (0 <= int).\n"
+                                     "\t4. Optionally, flags (1 for UTF-8, 2 to fold case, 4 to fold accents).";
 constexpr const auto DAMLEVLIM_ARG_TYPE_ERROR_LEN = std::size(DAMLEVLIM_ARG_TYPE_ERROR) + 1;
 
 // Use a "C" calling convention.
@@ -104,9 +108,19 @@ long long damlevlim(UDF_INIT *initid, UDF_ARGS *args, char *is_null, char *error
 void damlevlim_deinit(UDF_INIT *initid);
 }
 
+struct DamlevlimData {
+    OsaBuffer buffer;
+    long long flags;
+    FoldBuffer fold;
+    // The strings rewritten one byte per code point, in UTF-8 mode.
+    Utf8Buffer utf8;
+    // Scratch for the lower bounds, empty between rows.
+    OsaFilter filter;
+};
+
 bool damlevlim_init(UDF_INIT *initid, UDF_ARGS *args, char *message) {
-    // We require 3 arguments:
-    if (args->arg_count != 3) {
+    // We require 3 or 4 arguments:
+    if (args->arg_count != 3 && args->arg_count != 4) {
         strncpy(message, DAMLEVLIM_ARG_NUM_ERROR, DAMLEVLIM_ARG_NUM_ERROR_LEN);
         return 1;
     }
@@ -116,13 +130,20 @@ bool damlevlim_init(UDF_INIT *initid, UDF_ARGS *args, char *message) {
         strncpy(message, DAMLEVLIM_ARG_TYPE_ERROR, DAMLEVLIM_ARG_TYPE_ERROR_LEN);
         return 1;
     }
+    long long flags;
+    if (!damlev_flags(args, 3, flags)) {
+        strncpy(message, DAMLEV_FLAGS_ERROR, DAMLEV_FLAGS_ERROR_LEN);
+        return 1;
+    }
 
     // Attempt to allocate a buffer.
-    initid->ptr = (char *)new(std::nothrow) std::vector<size_t>(DAMLEVLIM_MAX_EDIT_DIST);
-    if (initid->ptr == nullptr) {
+    DamlevlimData *data = new(std::nothrow) DamlevlimData();
+    if (data == nullptr) {
         strncpy(message, DAMLEVLIM_MEM_ERROR, DAMLEVLIM_MEM_ERROR_LEN);
         return 1;
     }
+    data->flags = flags;
+    initid->ptr = (char *)data;
 
     // damlevlim does not return null.
     initid->maybe_null = 0;
@@ -130,49 +151,92 @@ bool damlevlim_init(UDF_INIT *initid, UDF_ARGS *args, char *message) {
 }
 
 void damlevlim_deinit(UDF_INIT *initid) {
-    delete[] initid->ptr;
+    delete (DamlevlimData *)initid->ptr;
 }
 
 long long damlevlim(UDF_INIT *initid, UDF_ARGS *args, UNUSED char *is_null, UNUSED char *error) {
     // Retrieve the arguments.
-    // Maximum edit distance.
-
-    int max_string_length = static_cast<double>(std::max(args->lengths[0],
-                                                                args->lengths[1]));
-    auto max = std::min(*((long long *)args->args[2]),
-             DAMLEVLIM_MAX_EDIT_DIST);
+    // Maximum edit distance. The kernels keep rows or tiles sized by the strings
+    // rather than by the limit, so it needs no cap; a wide band goes to osa_tiled.
+    long long max = *((long long *)args->args[2]);
 
     if (max == 0) {
         return 0ll;
     }
+
+    // Retrieve buffer.
+    DamlevlimData &data = *(DamlevlimData *)initid->ptr;
+    OsaBuffer &buffer = data.buffer;
+
+    // Let's make some string views so we can use the STL.
+    std::string_view subject{args->args[0] ? args->args[0] : "",
+                             args->args[0] ? args->lengths[0] : 0};
+    std::string_view query{args->args[1] ? args->args[1] : "",
+                           args->args[1] ? args->lengths[1] : 0};
+
+    // Fold case and accents first, so that everything after sees the folded strings.
+    subject = fold_string(subject, data.flags, data.fold.a);
+    query = fold_string(query, data.flags, data.fold.b);
+
+    // No distance is more than the longer length, and a smaller limit keeps the
+    // products with it below from overflowing.
+    max = std::min(max, (long long)std::max(subject.length(), query.length()));
+
+    // From here on a character is a byte, so rewrite the strings that way.
+    if ((data.flags & DAMLEV_UTF8) && !utf8_prepare(subject, query, data.utf8)) {
+        std::u32string_view wide_subject = data.utf8.wide_a;
+        std::u32string_view wide_query = data.utf8.wide_b;
+        const long long distance = osa_banded(wide_subject, wide_query, max,
+                                                   data.utf8.wide_rows);
+        if (distance > max) {
+            return (long long)std::max(wide_subject.length(), wide_query.length());
+        }
+        return distance;
+    }
+    int max_string_length = static_cast<double>(std::max(subject.length(), query.length()));
     #ifdef PRINT_DEBUG
     std::cout << "Maximum edit distance:" <<  max<<std::endl;
 
-    std::cout << "DAMLEVLIM_MAX_EDIT_DIST:" <<DAMLEVLIM_MAX_EDIT_DIST<<std::endl;
-
     std::cout << "Max String Length:" << max_string_length <<std::endl;
     #endif
 
-    if (args->args[0] == nullptr || args->lengths[0] == 0 || args->args[1] == nullptr ||
-            args->lengths[1] == 0) {
+    if (subject.empty() || query.empty()) {
         #ifdef PRINT_DEBUG
         std::cout << "String DNE, bailing" << std::endl;
         #endif
         // Either one of the strings doesn't exist, or one of the strings has
         // length zero. In either case
-        return (long long)std::max(args->lengths[0], args->lengths[1]);
+        return (long long)std::max(subject.length(), query.length());
     }
-    // Retrieve buffer.
-    std::vector<size_t> &buffer = *(std::vector<size_t> *)initid->ptr;
 
-    // Let's make some string views so we can use the STL.
-    std::string_view subject{args->args[0], args->lengths[0]};
-    std::string_view query{args->args[1], args->lengths[1]};
+    // Every alignment needs at least this many insertions or deletions, so there is no
+    // point looking at the strings.
+    const auto length_difference = std::max(subject.length(), query.length()) -
+                                   std::min(subject.length(), query.length());
+    if ((long long)length_difference > max) {
+        return max_string_length;
+    }
+
+    // Codes and names fit in a register, and a kernel built for the exact length
+    // beats trimming them.
+    if (subject.length() <= OSA_SHORT_MAX_LENGTH && query.length() <= OSA_SHORT_MAX_LENGTH) {
+        const long long distance = osa_short_distance(subject, query);
+        return distance > max ? max_string_length : distance;
+    }
+
+    // Most rows of a scan are nowhere near the query, and cheap lower bounds show it
+    // without running a kernel. The diagonal-transition kernel gives up on those
+    // even sooner, so they are only worth it in front of the banded ones.
+    if (max_string_length < OSA_TRANSITION_MIN_RATIO * max &&
+        osa_filter_rejects(data.filter, query, subject, max)) {
+        return max_string_length;
+    }
 
-    // Skip any common prefix.
-    auto[subject_begin, query_begin] =
-    std::mismatch(subject.begin(), subject.end(), query.begin(), query.end());
-    auto start_offset = (size_t)std::distance(subject.begin(), subject_begin);
+    // Skip any common prefix, a vector at a time since long documents can share a lot.
+    auto start_offset = osa_common_prefix(subject.data(), query.data(),
+                                          std::min(subject.length(), query.length()));
+    auto subject_begin = subject.begin() + start_offset;
+    auto query_begin = query.begin() + start_offset;
 
     // If one of the strings is a prefix of the other, done.
     if (subject.length() == start_offset) {
@@ -200,66 +264,31 @@ long long damlevlim(UDF_INIT *initid, UDF_ARGS *args, UNUSED char *is_null, UNUS
         query = query.substr(start_offset, query.size() - end_offset - start_offset);
     }
 
-    int trimmed_max = std::max(int(query.length()),int(subject.length()));
 #ifdef PRINT_DEBUG
-    std::cout << "trimmed max length:" <<trimmed_max<<std::endl;
     std::cout << "trimmed subject= " <<subject <<std::endl;
     std::cout <<"trimmed constant query= " <<query<<std::endl;
 #endif
 
-    // Make "subject" the smaller one.
-    if (query.length() < subject.length()) {
-
-        std::swap(subject, query);
-
-    }
-
-
-    // If one of the strings is a suffix of the other.
-    if (subject.length() == 0) {
-#ifdef PRINT_DEBUG
-        std::cout << subject << " is a suffix of " << query << ", bailing" << std::endl;
-#endif
-        return query.length();
-    }
-
-    int n = subject.size();
-    int m = query.size();
-
-    // Resize buffer to simulate a 2D matrix
-    buffer.resize((n + 1) * (m + 1));
-
-    // Function to access the 2D matrix simulated in a 1D vector
-    auto idx = [m](int i, int j) { return i * (m + 1) + j; };
-
-    // Initialize first row and column
-    for (int i = 0; i <= n; i++) {
-        buffer[idx(i, 0)] = i;
+    // A cheap alignment bounds the distance, so the band never has to be wider than
+    // its cost, and if that is just the length difference it is the distance.
+    const long long bound = osa_upper_bound(subject, query);
+    if (bound <= (long long)length_difference) {
+        return bound;
     }
-    for (int j = 0; j <= m; j++) {
-        buffer[idx(0, j)] = j;
+    const long long k = std::min(max, bound);
+
+    long long distance;
+    if ((long long)std::max(subject.length(), query.length()) >= OSA_TRANSITION_MIN_RATIO * k) {
+        // Long strings with a small limit: follow each diagonal from mismatch to
+        // mismatch instead of computing every cell near it.
+        distance = osa_transition(subject, query, k, buffer.furthest);
+    } else {
+        // Only the cells within `k` of the diagonal are computed, a row at a time
+        // while three rows of the band fit in cache and a tile at a time after that.
+        distance = osa_bounded(subject, query, k, buffer);
     }
-
-    for (int i = 1; i <= n; i++) {
-        size_t column_min = trimmed_max + 1;
-        for (int j = 1; j <= m; j++) {
-            int cost = (subject[i - 1] == query[j - 1]) ? 0 : 1;
-
-            buffer[idx(i, j)] = std::min({ buffer[idx(i - 1, j)] + 1,
-                                           buffer[idx(i, j - 1)] + 1,
-                                           buffer[idx(i - 1, j - 1)] + cost });
-
-            if (i > 1 && j > 1 && subject[i - 1] == query[j - 2] && subject[i - 2] == query[j - 1]) {
-                buffer[idx(i, j)] = std::min(buffer[idx(i, j)], buffer[idx(i - 2, j - 2)] + cost);
-            }
-
-            column_min = std::min(column_min, buffer[idx(i, j)]);
-        }
-
-        if (column_min > max) {
-            return max_string_length;
-        }
+    if (distance > max) {
+        return max_string_length;
     }
-    buffer.resize(DAMLEVLIM_MAX_EDIT_DIST);
-    return buffer[idx(n, m)];
-}
\ No newline at end of file
+    return distance;
+}
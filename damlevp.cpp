@@ -14,10 +14,14 @@
 
     Syntax:
 
-        DAMLEVP(String1, String2);
+        DAMLEVP(String1, String2[, Flags]);
 
     `String1`:  A string constant or column.
     `String2`:  A string constant or column to be compared to `String1`.
+    `Flags`:    An optional integer constant, the sum of any of: 1 to compare UTF-8
+                code points instead of bytes, so that "é" is one character; 2 to
+                ignore case; 4 to ignore accents, so that "é" matches "e" (see fold.h).
+                The lengths it is normalized by are then those of the folded strings.
 
     Returns: A floating point number equal to the normalized edit distance between `String1` and
     `String2`.
@@ -58,6 +62,9 @@
     IN THE SOFTWARE.
 */
 #include "common.h"
+#include "fold.h"
+#include "osa_simd.h"
+#include "utf8.h"
 //#define PRINT_DEBUG
 //#define PRINT_DEBUG
 #ifdef PRINT_DEBUG
@@ -69,7 +76,7 @@
     // bit boundary.
     #define DAMLEVP_BUFFER_SIZE 512ull
 #endif
-constexpr long long DAMLEVP_MAX_EDIT_DIST = std::max(0ull, std::min(16384ull,  DAMLEVP_BUFFER_SIZE));
+constexpr long long DAMLEVP_MAX_EDIT_DIST = DAMLEVP_BUFFER_SIZE;
 
 // Error messages.
 // MySQL error messages can be a maximum of MYSQL_ERRMSG_SIZE bytes long. In
@@ -77,17 +84,19 @@ constexpr long long DAMLEVP_MAX_EDIT_DIST = std::max(0ull, std::min(16384ull,  D
 // keep the error message less than 80 bytes long!" Rules were meant to be
 // broken.
 constexpr const char
-        DAMLEVP_ARG_NUM_ERROR[] = "Wrong number of arguments. DAMLEVP() requires two arguments:\n"
+        DAMLEVP_ARG_NUM_ERROR[] = "Wrong number of arguments. DAMLEVP() requires two or three arguments:\n"
                                  "\t1. A string.\n"
-                                 "\t2. Another string.";
+                                 "\t2. Another string.\n"
+                                 "\t3. Optionally, flags (1 for UTF-8, 2 to fold case, 4 to fold accents).";
 constexpr const auto DAMLEVP_ARG_NUM_ERROR_LEN = std::size(DAMLEVP_ARG_NUM_ERROR) + 1;
 constexpr const char DAMLEVP_MEM_ERROR[] = "Failed to allocate memory for DAMLEVP"
                                           " function.";
 constexpr const auto DAMLEVP_MEM_ERROR_LEN = std::size(DAMLEVP_MEM_ERROR) + 1;
 constexpr const char
-        DAMLEVP_ARG_TYPE_ERROR[] = "Arguments have wrong type. DAMLEVP() requires two arguments:\n"
+        DAMLEVP_ARG_TYPE_ERROR[] = "Arguments have wrong type. DAMLEVP() requires two or three arguments:\n"
                                   "\t1. A string.\n"
-                                  "\t2. Another string.";
+                                  "\t2. Another string.\n"
+                                  "\t3. Optionally, flags (1 for UTF-8, 2 to fold case, 4 to fold accents).";
 constexpr const auto DAMLEVP_ARG_TYPE_ERROR_LEN = std::size(DAMLEVP_ARG_TYPE_ERROR) + 1;
 
 // Use a "C" calling convention.
@@ -97,9 +106,17 @@ extern "C" {
     void damlevp_deinit(UDF_INIT *initid);
 }
 
+struct DamlevpData {
+    OsaBuffer buffer;
+    long long flags;
+    FoldBuffer fold;
+    // The strings rewritten one byte per code point, in UTF-8 mode.
+    Utf8Buffer utf8;
+};
+
 bool damlevp_init(UDF_INIT *initid, UDF_ARGS *args, char *message) {
-    // We require 2 arguments:
-    if (args->arg_count != 2) {
+    // We require 2 or 3 arguments:
+    if (args->arg_count != 2 && args->arg_count != 3) {
         strncpy(message, DAMLEVP_ARG_NUM_ERROR, DAMLEVP_ARG_NUM_ERROR_LEN);
         return 1;
     }
@@ -108,13 +125,20 @@ bool damlevp_init(UDF_INIT *initid, UDF_ARGS *args, char *message) {
         strncpy(message, DAMLEVP_ARG_TYPE_ERROR, DAMLEVP_ARG_TYPE_ERROR_LEN);
         return 1;
     }
+    long long flags;
+    if (!damlev_flags(args, 2, flags)) {
+        strncpy(message, DAMLEV_FLAGS_ERROR, DAMLEV_FLAGS_ERROR_LEN);
+        return 1;
+    }
 
     // Attempt to allocate a buffer.
-    initid->ptr = (char *)new(std::nothrow) std::vector<size_t>((DAMLEVP_MAX_EDIT_DIST));
-    if (initid->ptr == nullptr) {
+    DamlevpData *data = new(std::nothrow) DamlevpData();
+    if (data == nullptr) {
         strncpy(message, DAMLEVP_MEM_ERROR, DAMLEVP_MEM_ERROR_LEN);
         return 1;
     }
+    data->flags = flags;
+    initid->ptr = (char *)data;
 
     // damlevp does not return null.
     initid->maybe_null = 0;
@@ -122,7 +146,7 @@ bool damlevp_init(UDF_INIT *initid, UDF_ARGS *args, char *message) {
 }
 
 void damlevp_deinit(UDF_INIT *initid) {
-    delete[] initid->ptr;
+    delete (DamlevpData *)initid->ptr;
 }
 
 double damlevp(UDF_INIT *initid, UDF_ARGS *args, UNUSED char *is_null, UNUSED char *error) {
@@ -141,14 +165,31 @@ double damlevp(UDF_INIT *initid, UDF_ARGS *args, UNUSED char *is_null, UNUSED ch
 
     #endif
     // Retrieve buffer.
-    std::vector<size_t> &buffer = *(std::vector<size_t> *)initid->ptr;
-    // Save the original max string length for the normalization when we return.
-    const double max_string_length = static_cast<double>(std::max(args->lengths[0],
-            args->lengths[1]));
+    DamlevpData &data = *(DamlevpData *)initid->ptr;
+    OsaBuffer &buffer = data.buffer;
     // Let's make some string views so we can use the STL.
     std::string_view subject{args->args[0], args->lengths[0]};
     std::string_view query{args->args[1], args->lengths[1]};
 
+    // Fold case and accents first, so that everything after sees the folded strings.
+    subject = fold_string(subject, data.flags, data.fold.a);
+    query = fold_string(query, data.flags, data.fold.b);
+
+    // From here on a character is a byte, so rewrite the strings that way.
+    if ((data.flags & DAMLEV_UTF8) && !utf8_prepare(subject, query, data.utf8)) {
+        std::u32string_view wide_subject = data.utf8.wide_a;
+        std::u32string_view wide_query = data.utf8.wide_b;
+        return utf8_wide_distance(wide_subject, wide_query, data.utf8.wide_rows) /
+               static_cast<double>(std::max(wide_subject.length(), wide_query.length()));
+    }
+    // Folding can drop every character of a string.
+    if (subject.empty() || query.empty()) {
+        return 1.0;
+    }
+    // Save the max string length, as compared, for the normalization when we return.
+    const double max_string_length = static_cast<double>(std::max(subject.length(),
+            query.length()));
+
     // Skip any common prefix.
     auto[subject_begin, query_begin] =
     std::mismatch(subject.begin(), subject.end(), query.begin(), query.end());
@@ -159,12 +200,12 @@ double damlevp(UDF_INIT *initid, UDF_ARGS *args, UNUSED char *is_null, UNUSED ch
 #ifdef PRINT_DEBUG
         std::cout << subject << " is a prefix of " << query << ", bailing" << std::endl;
 #endif
-        return (size_t)(query.length() - start_offset);
+        return (query.length() - start_offset) / max_string_length;
     } else if (query.length() == start_offset) {
 #ifdef PRINT_DEBUG
         std::cout << query << " is a prefix of " << subject << ", bailing" << std::endl;
 #endif
-        return (size_t)(subject.length() - start_offset);
+        return (subject.length() - start_offset) / max_string_length;
     }
 
     // Skip any common suffix.
@@ -179,207 +220,12 @@ double damlevp(UDF_INIT *initid, UDF_ARGS *args, UNUSED char *is_null, UNUSED ch
         subject = subject.substr(start_offset, subject.size() - end_offset - start_offset);
         query = query.substr(start_offset, query.size() - end_offset - start_offset);
     }
-    int trimmed_max = std::max(int(query.length()),int(subject.length()));
 #ifdef PRINT_DEBUG
-    std::cout << "trimmed max length:" <<trimmed_max<<std::endl;
     std::cout << "trimmed subject= " <<subject <<std::endl;
     std::cout <<"trimmed constant query= " <<query<<std::endl;
 #endif
 
-    // Make "subject" the smaller one.
-    if (query.length() < subject.length()) {
-
-        std::swap(subject, query);
-
-    }
-
-
-    // If one of the strings is a suffix of the other.
-    if (subject.length() == 0) {
-#ifdef PRINT_DEBUG
-        std::cout << subject << " is a suffix of " << query << ", bailing" << std::endl;
-#endif
-        return query.length();
-    }
-
-
-    buffer.resize(trimmed_max+1);
-
-
-
-    // Init buffer.
-    std::iota(buffer.begin(), buffer.begin() + query.length() +1, 0);
-
-#ifdef PRINT_DEBUG
-    unsigned i = 0;
-    std::cout <<"    ";
-    for (auto a: query){
-        if (i <10) std::cout << a << " ";
-        else std::cout <<" "<< a<<" ";
-        i++;
-    }
-    std::cout <<std::endl;
-    std::cout <<"  ";
-    for (auto a: buffer)
-        std::cout << a << ' ';
-    std::cout <<std::endl;
-#endif
-    size_t end_j; // end_j is referenced after the loop.
-    size_t j;
-    //this for makes the vertical direction.
-    for (size_t i = 1; i < (subject.length() + 1); ++i) {
-
-
-        // temp is what we're calling the current value.
-        size_t temp = buffer[0]++; // counts up 1,2,3 ....
-
-
-        // prior_temp is used to give us the UP-LEFT value.
-        // The first UP-LEFT is always 0.
-        size_t prior_temp;
-        if (i ==1) {
-            prior_temp = 0 ;}
-
-
-
-
-        /* We don't need all the row data. We only needs to look in a window around answer it is
-         * between i-max <= j <= i+max
-         * The result of the max is positive,
-         * but we need the second argument to be allowed to be negative.
-         * Recall all the trimming we did, variable 'max' = trimmed_max
-         */
-
-        const size_t start_j = static_cast<size_t>(std::max(1ll, static_cast<long long>(i) -
-                                                                 trimmed_max/2-1));
-        end_j = std::min(static_cast<size_t>(query.length()+1),
-                         static_cast<size_t >(i + trimmed_max/2)+1);
-
-        size_t column_min = trimmed_max;     // Sentinels
-
-        // this loop makes the horizontal data.
-        for (size_t j = start_j; j < end_j; ++j) {
-            //for (size_t j = 1; j < 6; ++j) {
-
-
-            /*          a b c d
-             *       0  1 2 3 4
-             *    a  1  0 1 2 3
-             *    b  2  1 0 1 2
-             *    c  3  2 1 0 1
-             *    d  4  3 2 1 0
-             *
-             * We only need three items to calculate the edit_distance.
-             *
-             * LEFT, UP, UP-LEFT (Diagonal up to the left).
-             *
-             * By rule, if the letters are the same  a = a then the answer is always UP-LEFT.
-             *
-             * Robert has decided to accomplish this with a single vector called: buffer.
-             * Most damlev2D methods use the entire matrix or two rows.  This is a single row approach.
-             * We can access the previous rows' data that hasn't been overwritten yet.
-             *
-             * UP: buffer[j] is the previous rows' data directly above the current
-             * position, j
-             *
-             * LEFT: buffer[j-1] is the previous value to the left, same row,
-             * of the current position j.
-             *
-             * UP-LEFT prior_temp is from the previous row left, we set it at the first for loop.
-             * This gives us the left position of the previous rows, which is upper left from the current.
-             *
-             *
-             */
-
-            const size_t r = buffer[j]; // UP
-            const size_t p = buffer[j-1]; // LEFT
-
-            //std::cout <<"prior_temp: "<<prior_temp<<" r: "<<r<<" sub: "<<subject[i-1] <<" #";
-
-            size_t cost; // need to set a cost of a mistake for transposition below.
-            // are the values the same?
-            if (subject[i-1] == query[j-1]) {
-                temp = prior_temp; //UPPER LEFT
-                cost =0;  // same, zero cost
-
-
-            }
-
-            else  {
-                cost =1; // different cost of 1, this could be set to be something else.
-
-                // answer is always the min of the three values we have.
-                temp = std::min(std::min(r+ 1,   //  UP
-                                         p + 1   // LEFT
-                                ),
-                                prior_temp + 1  //UPPER LEFT
-                );
-            }
-
-
-
-
-            // We consider transposition,
-            // flipping of a pair of letters to be a cost of error not two
-            if( (i > 1) &&
-                (j > 1) &&
-                (subject[i-1] == query[j-2]) &&
-                (subject[i-2] == query[j-1])
-                    )
-            {
-                temp = std::min(
-                        temp + cost,
-                        prior_temp   // transposition
-                );
-
-            };
-
-            // Keep track of minimum value in each row. why is it called 'column_min'
-            // This will give us the ability to return if the edit distance is larger than the max
-            if (temp < column_min) {
-
-                column_min = temp;
-            }
-            // this sets UPPER LEFT for next loop
-            // this is not UPPER LEFT at the beginning of the loop
-            prior_temp = buffer[j];
-            buffer[j] = temp; // this sets UP for the next loop
-
-
-
-        }
-
-
-
-
-
-        // max is the maximum damlev2D, trimmed max is the max(trimmed.subject,trimmed.query)
-        // the max could be longer than the possible edit distance, so it would never bail early, likely not an issue, but..
-        if (column_min > max_string_length) {
-            // There is no way to get an edit distance > column_min.
-            // We can bail out early.
-
-            return max_string_length;
-
-
-        }
-        // print out the row data,
-#ifdef PRINT_DEBUG
-
-        std::cout <<subject[i-1]<<" ";
-
-
-        for (auto a: buffer) {
-            std::cout << a << ' ';
-        }
-        std::cout <<std::endl;
-#endif
-
-    }
-
-
-    double ld =static_cast<double> (buffer[end_j-1]/max_string_length);
-    buffer.resize(DAMLEVP_MAX_EDIT_DIST);
-    return ld;
+    // There is no limit: medium-length pairs go to the vectorised kernel, and
+    // everything else widens the band until it is wide enough to prove the distance.
+    return osa_distance(subject, query, buffer) / max_string_length;
 }
-
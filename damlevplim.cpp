@@ -0,0 +1,299 @@
+/*
+    Damerau–Levenshtein Edit Distance UDF for MySQL.
+
+    <hr>
+    `DAMLEVPLIM()` computes the normalized Damarau Levenshtein edit distance between two
+    strings when it is at most a given ratio. It is `DAMLEVP()` for `WHERE` clauses:
+    the ratio is turned into a limit on the edit distance for each row, the longer
+    length times the ratio, and the rest is `DAMLEVLIM()`, so a percent-match query
+    costs no more than one with a fixed limit.
+
+    Syntax:
+
+        DAMLEVPLIM(String1, String2, Ratio[, Flags]);
+
+    `String1`:  A string constant or column.
+    `String2`:  A string constant or column to be compared to `String1`.
+    `Ratio`:    A number from 0 to 1. If the normalized distance between `String1` and
+                `String2` is greater than `Ratio`, `DAMLEVPLIM()` will stop its
+                computation and return 1.0. For example, if you put
+                `WHERE DAMLEVPLIM(...) <= r` in a `WHERE`-clause, make `Ratio` be `r`.
+    `Flags`:    An optional integer constant, the sum of any of: 1 to compare UTF-8
+                code points instead of bytes, so that "é" is one character; 2 to
+                ignore case; 4 to ignore accents, so that "é" matches "e" (see fold.h).
+                The lengths it is normalized by are then those of the folded strings.
+
+    Returns: A floating point number equal to the normalized edit distance between
+    `String1` and `String2` if it is at most `Ratio`, or 1.0.
+
+    Example Usage:
+
+        SELECT Name, DAMLEVPLIM(Name, "Vladimir Iosifovich Levenshtein", 0.2) AS
+            EditDist FROM CUSTOMERS WHERE DAMLEVPLIM(Name, "Vladimir Iosifovich Levenshtein", 0.2) <= 0.2;
+
+    The above will return all rows `(Name, EditDist)` from the `CUSTOMERS` table
+    where `Name` has edit distance within 20% of "Vladimir Iosifovich Levenshtein".
+
+    <hr>
+
+    Released under the MIT license.
+
+    The MIT License
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to
+    deal in the Software without restriction, including without limitation the
+    rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+    sell copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in
+    all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+    IN THE SOFTWARE.
+*/
+#include "common.h"
+#include "osa.h"
+#include "osa_filter.h"
+#include "osa_short.h"
+#include "osa_tiled.h"
+#include "osa_transition.h"
+#include "fold.h"
+#include "utf8.h"
+//#define PRINT_DEBUG
+#ifdef PRINT_DEBUG
+#include <iostream>
+#endif
+
+// Error messages.
+// MySQL error messages can be a maximum of MYSQL_ERRMSG_SIZE bytes long. In
+// version 8.0, MYSQL_ERRMSG_SIZE == 512. However, the example says to "try to
+// keep the error message less than 80 bytes long!" Rules were meant to be
+// broken.
+constexpr const char
+        DAMLEVPLIM_ARG_NUM_ERROR[] = "Wrong number of arguments. DAMLEVPLIM() requires three or four arguments:\n"
+                                     "\t1. A string\n"
+                                     "\t2. A string\n"
+                                     "\t3. A maximum normalized distance (0 <= real <= 1).\n"
+                                     "\t4. Optionally, flags (1 for UTF-8, 2 to fold case, 4 to fold accents).";
+constexpr const auto DAMLEVPLIM_ARG_NUM_ERROR_LEN = std::size(DAMLEVPLIM_ARG_NUM_ERROR) + 1;
+constexpr const char DAMLEVPLIM_MEM_ERROR[] = "Failed to allocate memory for DAMLEVPLIM"
+                                              " function.";
+constexpr const auto DAMLEVPLIM_MEM_ERROR_LEN = std::size(DAMLEVPLIM_MEM_ERROR) + 1;
+constexpr const char
+        DAMLEVPLIM_ARG_TYPE_ERROR[] = "Arguments have wrong type. DAMLEVPLIM() requires three or four arguments:\n"
+                                      "\t1. A string\n"
+                                      "\t2. A string\n"
+                                      "\t3. A maximum normalized distance (0 <= real <= 1).\n"
+                                      "\t4. Optionally, flags (1 for UTF-8, 2 to fold case, 4 to fold accents).";
+constexpr const auto DAMLEVPLIM_ARG_TYPE_ERROR_LEN = std::size(DAMLEVPLIM_ARG_TYPE_ERROR) + 1;
+
+// Use a "C" calling convention.
+extern "C" {
+bool damlevplim_init(UDF_INIT *initid, UDF_ARGS *args, char *message);
+double damlevplim(UDF_INIT *initid, UDF_ARGS *args, char *is_null, char *error);
+void damlevplim_deinit(UDF_INIT *initid);
+}
+
+struct DamlevplimData {
+    OsaBuffer buffer;
+    long long flags;
+    FoldBuffer fold;
+    // The strings rewritten one byte per code point, in UTF-8 mode.
+    Utf8Buffer utf8;
+    // Scratch for the lower bounds, empty between rows.
+    OsaFilter filter;
+};
+
+namespace {
+
+// The largest distance whose ratio to `length` is at most `ratio`, compared the way
+// DAMLEVP's result would be, so that the two agree on every row.
+long long damlevplim_limit(double ratio, size_t length) {
+    long long limit = (long long)(ratio * (double)length);
+    while (limit > 0 && (double)limit / (double)length > ratio) {
+        --limit;
+    }
+    while (limit < (long long)length && (double)(limit + 1) / (double)length <= ratio) {
+        ++limit;
+    }
+    return limit;
+}
+
+} // namespace
+
+bool damlevplim_init(UDF_INIT *initid, UDF_ARGS *args, char *message) {
+    // We require 3 or 4 arguments:
+    if (args->arg_count != 3 && args->arg_count != 4) {
+        strncpy(message, DAMLEVPLIM_ARG_NUM_ERROR, DAMLEVPLIM_ARG_NUM_ERROR_LEN);
+        return 1;
+    }
+    // The arguments needs to be of the right type.
+    else if (args->arg_type[0] != STRING_RESULT || args->arg_type[1] != STRING_RESULT ||
+             args->arg_type[2] == STRING_RESULT) {
+        strncpy(message, DAMLEVPLIM_ARG_TYPE_ERROR, DAMLEVPLIM_ARG_TYPE_ERROR_LEN);
+        return 1;
+    }
+    long long flags;
+    if (!damlev_flags(args, 3, flags)) {
+        strncpy(message, DAMLEV_FLAGS_ERROR, DAMLEV_FLAGS_ERROR_LEN);
+        return 1;
+    }
+    // Have MySQL hand over the ratio as a double, whether it was written as 0.2 or 1.
+    args->arg_type[2] = REAL_RESULT;
+
+    // Attempt to allocate a buffer.
+    DamlevplimData *data = new(std::nothrow) DamlevplimData();
+    if (data == nullptr) {
+        strncpy(message, DAMLEVPLIM_MEM_ERROR, DAMLEVPLIM_MEM_ERROR_LEN);
+        return 1;
+    }
+    data->flags = flags;
+    initid->ptr = (char *)data;
+
+    // damlevplim does not return null.
+    initid->maybe_null = 0;
+    return 0;
+}
+
+void damlevplim_deinit(UDF_INIT *initid) {
+    delete (DamlevplimData *)initid->ptr;
+}
+
+double damlevplim(UDF_INIT *initid, UDF_ARGS *args, UNUSED char *is_null, UNUSED char *error) {
+    // Retrieve the arguments. Without a ratio, every distance is of interest.
+    const double ratio = nullptr == args->args[2]
+                                 ? 1.0
+                                 : std::min(1.0, std::max(0.0, *((double *)args->args[2])));
+
+    // Retrieve buffer.
+    DamlevplimData &data = *(DamlevplimData *)initid->ptr;
+    OsaBuffer &buffer = data.buffer;
+
+    // Let's make some string views so we can use the STL.
+    std::string_view subject = damlev_string(args, 0);
+    std::string_view query = damlev_string(args, 1);
+
+    // Fold case and accents first, so that everything after sees the folded strings.
+    subject = fold_string(subject, data.flags, data.fold.a);
+    query = fold_string(query, data.flags, data.fold.b);
+
+    // From here on a character is a byte, so rewrite the strings that way.
+    if ((data.flags & DAMLEV_UTF8) && !utf8_prepare(subject, query, data.utf8)) {
+        std::u32string_view wide_subject = data.utf8.wide_a;
+        std::u32string_view wide_query = data.utf8.wide_b;
+        const size_t longer = std::max(wide_subject.length(), wide_query.length());
+        if (wide_subject.empty() || wide_query.empty()) {
+            return 1.0;
+        }
+        const long long max = damlevplim_limit(ratio, longer);
+        const long long distance = osa_banded(wide_subject, wide_query, max,
+                                              data.utf8.wide_rows);
+        return distance > max ? 1.0 : distance / static_cast<double>(longer);
+    }
+
+    if (subject.empty() || query.empty()) {
+        // Either one of the strings doesn't exist, or one of the strings has
+        // length zero. In either case
+        return 1.0;
+    }
+
+    // The ratio as a limit on the distance for this row.
+    const int max_string_length = (int)std::max(subject.length(), query.length());
+    const long long max = damlevplim_limit(ratio, max_string_length);
+    const double length = static_cast<double>(max_string_length);
+#ifdef PRINT_DEBUG
+    std::cout << "Maximum edit distance:" << max << std::endl;
+    std::cout << "Max String Length:" << max_string_length << std::endl;
+#endif
+
+    // Every alignment needs at least this many insertions or deletions, so there is no
+    // point looking at the strings.
+    const auto length_difference = std::max(subject.length(), query.length()) -
+                                   std::min(subject.length(), query.length());
+    if ((long long)length_difference > max) {
+        return 1.0;
+    }
+
+    // Codes and names fit in a register, and a kernel built for the exact length
+    // beats trimming them.
+    if (subject.length() <= OSA_SHORT_MAX_LENGTH && query.length() <= OSA_SHORT_MAX_LENGTH) {
+        const long long distance = osa_short_distance(subject, query);
+        return distance > max ? 1.0 : distance / length;
+    }
+
+    // Most rows of a scan are nowhere near the query, and cheap lower bounds show it
+    // without running a kernel, in front of the banded kernels as in DAMLEVLIM.
+    if (max_string_length < OSA_TRANSITION_MIN_RATIO * max &&
+        osa_filter_rejects(data.filter, query, subject, max)) {
+        return 1.0;
+    }
+
+    // Skip any common prefix, a vector at a time since long documents can share a lot.
+    auto start_offset = osa_common_prefix(subject.data(), query.data(),
+                                          std::min(subject.length(), query.length()));
+    auto subject_begin = subject.begin() + start_offset;
+    auto query_begin = query.begin() + start_offset;
+
+    // If one of the strings is a prefix of the other, the distance is the length
+    // difference, which is within the limit.
+    if (subject.length() == start_offset || query.length() == start_offset) {
+#ifdef PRINT_DEBUG
+        std::cout << "One string is a prefix of the other, bailing" << std::endl;
+#endif
+        return length_difference / length;
+    }
+
+    // Skip any common suffix.
+    auto[subject_end, query_end] = std::mismatch(
+            subject.rbegin(), static_cast<decltype(subject.rend())>(subject_begin),
+            query.rbegin(), static_cast<decltype(query.rend())>(query_begin));
+    auto end_offset = std::min((size_t)std::distance(subject.rbegin(), subject_end),
+                               (size_t)(subject.size() - start_offset));
+
+    // Take the different part.
+    if (start_offset > 2 && end_offset > 2) {
+        subject = subject.substr(start_offset, subject.size() - end_offset - start_offset);
+        query = query.substr(start_offset, query.size() - end_offset - start_offset);
+    }
+
+#ifdef PRINT_DEBUG
+    std::cout << "trimmed subject= " << subject << std::endl;
+    std::cout << "trimmed query= " << query << std::endl;
+#endif
+
+    // A cheap alignment bounds the distance, so the band never has to be wider than
+    // its cost, and if that is just the length difference it is the distance.
+    const long long bound = osa_upper_bound(subject, query);
+    if (bound <= (long long)length_difference) {
+        return bound / length;
+    }
+    const long long k = std::min(max, bound);
+
+    // A ratio makes for wide bands on long strings, where the vectorised kernel
+    // computing every cell beats the banded ones.
+    const size_t shorter = std::min(subject.length(), query.length());
+    const size_t longer = std::max(subject.length(), query.length());
+    long long distance;
+    if (osa_simd_beats_band(shorter, longer, k)) {
+        distance = osa_distance(subject, query, buffer);
+    } else if ((long long)longer >= OSA_TRANSITION_MIN_RATIO * k) {
+        // Long strings with a small limit: follow each diagonal from mismatch to
+        // mismatch instead of computing every cell near it.
+        distance = osa_transition(subject, query, k, buffer.furthest);
+    } else {
+        // Only the cells within `k` of the diagonal are computed, a row at a time
+        // while three rows of the band fit in cache and a tile at a time after that.
+        distance = osa_bounded(subject, query, k, buffer);
+    }
+    if (distance > max) {
+        return 1.0;
+    }
+    return distance / length;
+}
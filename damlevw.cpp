@@ -0,0 +1,184 @@
+/*
+    Weighted Damerau–Levenshtein Edit Distance UDF for MySQL.
+
+    <hr>
+    `DAMLEVW()` computes the Damarau Levenshtein edit distance between two strings
+    when some edits are cheaper than others, such as the substitutions an OCR engine
+    or a keyboard makes most often.
+
+    Syntax:
+
+        DAMLEVW(String1, String2, Costs, PosReal);
+
+    `String1`:  A string constant or column.
+    `String2`:  A string constant or column to be compared to `String1`.
+    `Costs`:    A constant string of comma separated KEY=WEIGHT entries; see
+                osa_weighted.h. For example, "0O=0.2,1l=0.3,+ =0.5" makes 0/O and 1/l
+                confusions and inserted spaces cheap. Every other edit costs 1.
+    `PosReal`:  A positive number. If the distance between `String1` and `String2`
+                is greater than `PosReal`, `DAMLEVW()` stops early and returns the
+                cost of deleting all of `String1` and inserting all of `String2`,
+                which is always an upper bound.
+
+    Returns: Either a real number equal to the weighted edit distance between
+    `String1` and `String2`, or the upper bound above.
+
+    Example Usage:
+
+        SELECT Serial FROM PARTS
+            WHERE DAMLEVW(Serial, "B0L7-118", "0O=0.2,1l=0.2,8B=0.3", 1) <= 1;
+
+    The above will return every `Serial` that is within a few likely misreadings of
+    "B0L7-118".
+
+    <hr>
+
+    The cost specification is parsed in `damlevw_init()` into dense tables, so every
+    row only does table lookups.
+
+    Released under the MIT license.
+
+    The MIT License
+
+    Permission is hereby granted, free of charge, to any person obtaining a copy
+    of this software and associated documentation files (the "Software"), to
+    deal in the Software without restriction, including without limitation the
+    rights to use, copy, modify, merge, publish, distribute, sublicense, and/or
+    sell copies of the Software, and to permit persons to whom the Software is
+    furnished to do so, subject to the following conditions:
+
+    The above copyright notice and this permission notice shall be included in
+    all copies or substantial portions of the Software.
+
+    THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+    IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+    FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+    AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+    LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+    FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+    IN THE SOFTWARE.
+*/
+#include "common.h"
+#include "osa_weighted.h"
+//#define PRINT_DEBUG
+#ifdef PRINT_DEBUG
+#include <iostream>
+#endif
+
+// Error messages.
+// MySQL error messages can be a maximum of MYSQL_ERRMSG_SIZE bytes long. In
+// version 8.0, MYSQL_ERRMSG_SIZE == 512. However, the example says to "try to
+// keep the error message less than 80 bytes long!" Rules were meant to be
+// broken.
+constexpr const char
+        DAMLEVW_ARG_NUM_ERROR[] = "Wrong number of arguments. DAMLEVW() requires four arguments:\n"
+                                  "\t1. A string.\n"
+                                  "\t2. Another string.\n"
+                                  "\t3. A constant cost specification.\n"
+                                  "\t4. A maximum distance (0 <= real).";
+constexpr const auto DAMLEVW_ARG_NUM_ERROR_LEN = std::size(DAMLEVW_ARG_NUM_ERROR) + 1;
+constexpr const char DAMLEVW_MEM_ERROR[] = "Failed to allocate memory for DAMLEVW"
+                                           " function.";
+constexpr const auto DAMLEVW_MEM_ERROR_LEN = std::size(DAMLEVW_MEM_ERROR) + 1;
+constexpr const char
+        DAMLEVW_ARG_TYPE_ERROR[] = "Arguments have wrong type. DAMLEVW() requires four arguments:\n"
+                                   "\t1. A string.\n"
+                                   "\t2. Another string.\n"
+                                   "\t3. A constant cost specification.\n"
+                                   "\t4. A maximum distance (0 <= real).";
+constexpr const auto DAMLEVW_ARG_TYPE_ERROR_LEN = std::size(DAMLEVW_ARG_TYPE_ERROR) + 1;
+constexpr const char
+        DAMLEVW_COSTS_ERROR[] = "Invalid cost specification for DAMLEVW(). Expected a constant list\n"
+                                "of KEY=WEIGHT entries, such as \"*=1,0O=0.2,+ =0.5\", with\n"
+                                "non-negative weights and insertions and deletions above zero.";
+constexpr const auto DAMLEVW_COSTS_ERROR_LEN = std::size(DAMLEVW_COSTS_ERROR) + 1;
+
+// Use a "C" calling convention.
+extern "C" {
+bool damlevw_init(UDF_INIT *initid, UDF_ARGS *args, char *message);
+double damlevw(UDF_INIT *initid, UDF_ARGS *args, char *is_null, char *error);
+void damlevw_deinit(UDF_INIT *initid);
+}
+
+struct WeightedData {
+    // The parsed cost specification.
+    OsaCosts costs;
+    // Three rows of the band.
+    std::vector<double> buffer;
+};
+
+bool damlevw_init(UDF_INIT *initid, UDF_ARGS *args, char *message) {
+    // We require 4 arguments:
+    if (args->arg_count != 4) {
+        strncpy(message, DAMLEVW_ARG_NUM_ERROR, DAMLEVW_ARG_NUM_ERROR_LEN);
+        return 1;
+    }
+    // The arguments needs to be of the right type.
+    else if (args->arg_type[0] != STRING_RESULT || args->arg_type[1] != STRING_RESULT ||
+             args->arg_type[2] != STRING_RESULT || args->arg_type[3] == STRING_RESULT) {
+        strncpy(message, DAMLEVW_ARG_TYPE_ERROR, DAMLEVW_ARG_TYPE_ERROR_LEN);
+        return 1;
+    }
+    // Have MySQL hand over the limit as a double, whether it was written as 1 or 1.5.
+    args->arg_type[3] = REAL_RESULT;
+
+    // Attempt to allocate persistent data.
+    WeightedData *data = new(std::nothrow) WeightedData();
+    if (nullptr == data) {
+        strncpy(message, DAMLEVW_MEM_ERROR, DAMLEVW_MEM_ERROR_LEN);
+        return 1;
+    }
+    // Constant arguments are already known here, and the costs have to be.
+    if (nullptr == args->args[2] ||
+        !osa_costs_parse({args->args[2], args->lengths[2]}, data->costs)) {
+        delete data;
+        strncpy(message, DAMLEVW_COSTS_ERROR, DAMLEVW_COSTS_ERROR_LEN);
+        return 1;
+    }
+    initid->ptr = (char *)data;
+
+    // damlevw does not return null.
+    initid->maybe_null = 0;
+    return 0;
+}
+
+void damlevw_deinit(UDF_INIT *initid) {
+    delete (WeightedData *)initid->ptr;
+}
+
+double damlevw(UDF_INIT *initid, UDF_ARGS *args, UNUSED char *is_null, UNUSED char *error) {
+    WeightedData &data = *(WeightedData *)initid->ptr;
+    const OsaCosts &costs = data.costs;
+
+    std::string_view subject{args->args[0] ? args->args[0] : "",
+                             args->args[0] ? args->lengths[0] : 0};
+    std::string_view query{args->args[1] ? args->args[1] : "",
+                           args->args[1] ? args->lengths[1] : 0};
+
+    // Deleting all of one string and inserting all of the other always works.
+    double everything = 0.0;
+    for (unsigned char c : subject) {
+        everything += costs.erase[c];
+    }
+    for (unsigned char c : query) {
+        everything += costs.insert[c];
+    }
+    if (subject.empty() || query.empty()) {
+        return everything;
+    }
+    const double max = nullptr == args->args[3]
+                               ? everything
+                               : std::max(0.0, *((double *)args->args[3]));
+
+#ifdef PRINT_DEBUG
+    std::cout << "subject= " << subject << std::endl;
+    std::cout << "query= " << query << std::endl;
+    std::cout << "Maximum edit distance:" << max << std::endl;
+#endif
+
+    const double distance = osa_weighted(subject, query, costs, max, data.buffer);
+    if (distance > max) {
+        return everything;
+    }
+    return distance;
+}
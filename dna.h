@@ -0,0 +1,70 @@
+/*
+    A four-letter alphabet for nucleotide sequences, for `DAMLEV_DNA()`.
+
+    The bit-parallel kernels keep one match mask per character the text can contain,
+    which for bytes is a table of 256 masks per block of the pattern that has to be
+    cleared and filled for every pattern. Bases only need four: A, C, G and T (or U),
+    in either case, are mapped to the codes 0 to 3, and everything else, N included,
+    to a fifth code whose mask is always empty. The table for a pattern of up to 64
+    bases is then five words, which takes a few instructions to build and never
+    leaves L1.
+
+    An unknown base matches nothing, not even another N, as is usual for barcodes and
+    reads where N is a base the sequencer could not call.
+
+    Released under the MIT license. See LICENSE.txt.
+*/
+
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+#include "bitparallel.h"
+
+// A, C, G, T, and the code of everything else.
+constexpr size_t DNA_ALPHABET_SIZE = 5;
+constexpr unsigned char DNA_UNKNOWN = 4;
+
+struct DnaCodes {
+    unsigned char code[256];
+
+    constexpr DnaCodes() : code() {
+        for (unsigned c = 0; c < 256; ++c) {
+            code[c] = DNA_UNKNOWN;
+        }
+        code['A'] = code['a'] = 0;
+        code['C'] = code['c'] = 1;
+        code['G'] = code['g'] = 2;
+        code['T'] = code['t'] = 3;
+        code['U'] = code['u'] = 3;
+    }
+};
+constexpr DnaCodes DNA_CODES{};
+
+// The alphabet the OSA kernels in bitparallel.h read the text with.
+struct DnaAlphabet {
+    static unsigned char code(char c) { return DNA_CODES.code[(unsigned char)c]; }
+};
+
+// Whether two characters are the same known base.
+inline bool dna_match(char a, char b) {
+    const unsigned char code = DnaAlphabet::code(a);
+    return DNA_UNKNOWN != code && code == DnaAlphabet::code(b);
+}
+
+// Fills `peq`, which must have room for `DNA_ALPHABET_SIZE * words` words, with the
+// match masks of the first `64 * words` bases of `pattern`, laid out as
+// `peq[code * words + w]`.
+inline void dna_build_peq(std::string_view pattern, uint64_t *peq, size_t words) {
+    std::fill(peq, peq + DNA_ALPHABET_SIZE * words, 0ull);
+    const size_t m = std::min(pattern.length(), BITPAR_WORD_BITS * words);
+    for (size_t i = 0; i < m; ++i) {
+        peq[DnaAlphabet::code(pattern[i]) * words + i / BITPAR_WORD_BITS] |=
+                1ull << (i % BITPAR_WORD_BITS);
+    }
+    // Unknown bases match nothing.
+    std::fill(peq + DNA_UNKNOWN * words, peq + DNA_ALPHABET_SIZE * words, 0ull);
+}
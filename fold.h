@@ -0,0 +1,141 @@
+/*
+    Case and accent folding for the flags argument of the edit distance UDFs.
+
+    Comparing names usually means wrapping both arguments in LOWER() and something to
+    strip accents, which builds two new strings per row inside the server. Folding
+    here instead writes each string once into a buffer that lives for the whole
+    statement, and the kernels read it straight from there:
+
+    * Pure ASCII, which osa_is_ascii checks a vector at a time, only needs its case
+      folded, in a branch-free loop the compiler vectorises. With only accents to fold
+      it is not copied at all.
+    * Anything else is decoded a code point at a time, folded, and encoded again.
+
+    DAMLEV_FOLD_CASE lowers the letters of ASCII, Latin-1, Latin Extended-A, and the
+    basic Greek and Cyrillic alphabets. DAMLEV_FOLD_ACCENTS turns the accented letters
+    of Latin-1 and Latin Extended-A into their base letters, so "Dvořák" becomes
+    "Dvorak", and drops combining accents, as in a decomposed "é". Letters that are
+    not an accent away from ASCII, like "ß", "æ" or "þ", are left alone.
+
+    Folding always reads the strings as UTF-8, whether or not DAMLEV_UTF8 is set;
+    bytes that are not UTF-8 are kept as they are.
+
+    Released under the MIT license. See LICENSE.txt.
+*/
+
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <string_view>
+
+#include "common.h"
+#include "osa_simd.h"
+#include "utf8.h"
+
+// The first code point FOLD_LATIN_BASE covers.
+constexpr char32_t FOLD_LATIN_FIRST = 0xc0;
+// The base letter of every code point from U+00C0 to U+017F, or '.' if it has none.
+constexpr char FOLD_LATIN_BASE[] =
+        "AAAAAA.CEEEEIIII" "DNOOOOO.OUUUUY.." "aaaaaa.ceeeeiiii" "dnooooo.ouuuuy.y"
+        "AaAaAaCcCcCcCcDd" "DdEeEeEeEeEeGgGg" "GgGgHhHhIiIiIiIi" "Ii..JjKk.LlLlLlL"
+        "lLlNnNnNn...OoOo" "Oo..RrRrRrSsSsSs" "SsTtTtTtUuUuUuUu" "UuUuWwYyYZzZzZz.";
+// What a code point folds to when it is to be dropped.
+constexpr char32_t FOLD_DROPPED = 0xffffffff;
+
+// Lowers the letters of ASCII, Latin-1, Latin Extended-A, Greek and Cyrillic.
+inline char32_t fold_case(char32_t c) {
+    if (c < 0x80) {
+        return c - 'A' < 26 ? c + 0x20 : c;
+    }
+    if (c < 0x100) {
+        return c >= 0xc0 && c <= 0xde && c != 0xd7 ? c + 0x20 : c;
+    }
+    if (c < 0x180) {
+        // Latin Extended-A comes in pairs, upper case first, except that the pairs
+        // from Ĺ to ň and from Ź to ž start on odd code points.
+        if (0x178 == c) {
+            return 0xff;
+        }
+        const bool odd_pairs = (c >= 0x139 && c <= 0x148) || (c >= 0x179 && c <= 0x17e);
+        const bool paired = odd_pairs || (c <= 0x137) || (c >= 0x14a && c <= 0x177);
+        return paired && (c & 1) == (odd_pairs ? 1u : 0u) ? c + 1 : c;
+    }
+    if (c >= 0x391 && c <= 0x3a9 && c != 0x3a2) {
+        return c + 0x20;
+    }
+    if (c >= 0x400 && c <= 0x40f) {
+        return c + 0x50;
+    }
+    if (c >= 0x410 && c <= 0x42f) {
+        return c + 0x20;
+    }
+    return c;
+}
+
+// Folds a code point as `flags` asks. Returns FOLD_DROPPED if it should go.
+inline char32_t fold_code_point(char32_t c, long long flags) {
+    if (flags & DAMLEV_FOLD_ACCENTS) {
+        if (c >= 0x300 && c <= 0x36f) {
+            return FOLD_DROPPED;
+        }
+        if (c >= FOLD_LATIN_FIRST && c < FOLD_LATIN_FIRST + sizeof(FOLD_LATIN_BASE) - 1 &&
+            '.' != FOLD_LATIN_BASE[c - FOLD_LATIN_FIRST]) {
+            c = (unsigned char)FOLD_LATIN_BASE[c - FOLD_LATIN_FIRST];
+        }
+    }
+    if (flags & DAMLEV_FOLD_CASE) {
+        c = fold_case(c);
+    }
+    return c;
+}
+
+// Lowers the ASCII letters of `s` into `out`, which needs room for `length` bytes.
+inline void fold_ascii_case(const char *s, size_t length, char *out) {
+    for (size_t i = 0; i < length; ++i) {
+        const unsigned char c = (unsigned char)s[i];
+        out[i] = (char)((unsigned char)(c - 'A') < 26 ? c | 0x20 : c);
+    }
+}
+
+/*
+    Folds `s` as `flags` asks. Returns the folded string, which is written to `out`,
+    or is `s` itself if folding can not change it.
+*/
+inline std::string_view fold_string(std::string_view s, long long flags, std::string &out) {
+    if (0 == (flags & (DAMLEV_FOLD_CASE | DAMLEV_FOLD_ACCENTS))) {
+        return s;
+    }
+    if (osa_is_ascii(s.data(), s.length())) {
+        if (0 == (flags & DAMLEV_FOLD_CASE)) {
+            return s;
+        }
+        out.resize(s.length());
+        fold_ascii_case(s.data(), s.length(), out.data());
+        return out;
+    }
+
+    out.clear();
+    const unsigned char *p = (const unsigned char *)s.data();
+    const unsigned char *end = p + s.length();
+    while (p < end) {
+        const unsigned char *start = p;
+        const char32_t code_point = utf8_next(p, end);
+        if (code_point > 0x10ffff) {
+            // Not UTF-8, so keep the byte.
+            out.push_back((char)*start);
+            continue;
+        }
+        const char32_t folded = fold_code_point(code_point, flags);
+        if (FOLD_DROPPED != folded) {
+            utf8_append(folded, out);
+        }
+    }
+    return out;
+}
+
+// Per-statement storage for the folded strings.
+struct FoldBuffer {
+    std::string a;
+    std::string b;
+};
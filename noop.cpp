@@ -43,8 +43,7 @@
 // 640k should be good enough for anybody.
 #define NOOP_BUFFER_SIZE 512ull
 #endif
-constexpr long long NOOP_MAX_EDIT_DIST = std::max(0ull,
-                                                       std::min(16384ull, NOOP_BUFFER_SIZE));
+constexpr long long NOOP_MAX_EDIT_DIST = NOOP_BUFFER_SIZE;
 
 // Error messages.
 // MySQL error messages can be a maximum of MYSQL_ERRMSG_SIZE bytes long. In
@@ -0,0 +1,265 @@
+/*
+    Dynamic programming kernels for the optimal string alignment (restricted
+    Damerau–Levenshtein) distance.
+
+    The recurrence is the one every UDF in this library has always used:
+
+        D[i][j] = min(D[i-1][j] + 1, D[i][j-1] + 1, D[i-1][j-1] + cost,
+                      D[i-2][j-2] + cost  if a[i-1] == b[j-2] && a[i-2] == b[j-1])
+
+    where cost is 0 if a[i-1] == b[j-1] and 1 otherwise. The transposition term is why
+    three rows of the matrix have to be kept around instead of the usual two.
+
+    Released under the MIT license. See LICENSE.txt.
+*/
+
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <string_view>
+#include <vector>
+
+/*
+    Row storage for the kernels below, one vector per cell width. Each call only
+    touches the narrowest one that can hold its values, so a buffer reused across
+    rows settles at the size its longest strings need and stops reallocating.
+*/
+struct OsaBuffer {
+    std::vector<uint8_t> cells8;
+    std::vector<uint16_t> cells16;
+    std::vector<uint32_t> cells32;
+    std::vector<size_t> cells64;
+    // Furthest rows per diagonal, for osa_transition.
+    std::vector<long long> furthest;
+};
+
+/*
+    Computes the distance between `a` and `b` if it is at most `max`, and returns some
+    value greater than `max` otherwise.
+
+    Only the cells in Ukkonen's band are computed: an alignment of cost at most `max`
+    can only pass through cell (i, j) if both |i - j| and |(n - i) - (m - j)| are at
+    most `max`. That leaves at most 2*max + 1 cells per row, so time is proportional
+    to `max` rather than to the size of the matrix. The matrix itself is never
+    stored: the shorter string runs along the rows, and only the three rows the
+    recurrence looks at are kept, so memory is proportional to the shorter length.
+
+    Cells are capped at k + 1, so `Cell` only has to hold k + 1; arithmetic is done in size_t.
+    Characters are bytes, or code points for the UTF-8 mode (see utf8.h).
+*/
+template <typename Cell, typename Char>
+long long osa_banded_cells(std::basic_string_view<Char> a, std::basic_string_view<Char> b,
+                           long long max, std::vector<Cell> &buffer) {
+    // The distance is symmetric, so keep the rows as short as possible.
+    if (b.length() > a.length()) {
+        std::swap(a, b);
+    }
+    const long long n = (long long)a.length();
+    const long long m = (long long)b.length();
+    const long long d = m - n;
+
+    // Every alignment needs at least |n - m| insertions or deletions.
+    if (std::abs(d) > max) {
+        return max + 1;
+    }
+    if (0 == m) {
+        return n;
+    }
+
+    const long long k = std::min(max, n);
+    // Row i holds the cells i + lo <= j <= i + hi.
+    const long long lo = std::max(-k, d - k);
+    const long long hi = std::min(k, d + k);
+    // Values above k are all the same to us, and capping them keeps them small.
+    const Cell inf = (Cell)(k + 1);
+
+    // Cell (i, j) lives at index j + 1 of its row. Index 0 and the index just past
+    // the band hold `inf`, so neighbours outside the band need no bounds checks.
+    const size_t stride = (size_t)m + 3;
+    if (buffer.size() < 3 * stride) {
+        buffer.resize(3 * stride);
+    }
+    Cell *before = buffer.data();
+    Cell *above = before + stride;
+    Cell *current = above + stride;
+
+    above[0] = inf;
+    for (long long j = 0; j <= hi; ++j) {
+        above[j + 1] = (Cell)j;
+    }
+    above[hi + 2] = inf;
+
+    for (long long i = 1; i <= n; ++i) {
+        const long long j_begin = std::max(0ll, i + lo);
+        const long long j_end = std::min(m, i + hi);
+        // The cheapest any alignment through a cell of this row can end up.
+        size_t row_bound = inf;
+        current[j_begin] = inf;
+        long long j = j_begin;
+        // Column 0, if it is still in the band.
+        if (0 == j) {
+            current[1] = (Cell)i;
+            row_bound = (size_t)(i + std::abs(d + i));
+            ++j;
+        }
+
+        const Char a_i = a[i - 1];
+        for (; j <= j_end; ++j) {
+            const size_t cost = a_i == b[j - 1] ? 0 : 1;
+            size_t value = std::min({(size_t)above[j + 1] + 1,  // D[i-1][j]
+                                     (size_t)current[j] + 1,    // D[i][j-1]
+                                     (size_t)above[j] + cost}); // D[i-1][j-1]
+            if (i > 1 && j > 1 && a_i == b[j - 2] && a[i - 2] == b[j - 1]) {
+                value = std::min(value, (size_t)before[j - 1] + cost); // D[i-2][j-2]
+            }
+            value = std::min(value, (size_t)inf);
+            current[j + 1] = (Cell)value;
+            row_bound = std::min(row_bound, value + (size_t)std::abs(d - (j - i)));
+        }
+        current[j_end + 2] = inf;
+
+        // Row minima never decrease, even across a transposition, so if no cell in
+        // this row can lead to an alignment of cost at most k, none later can.
+        if (row_bound > (size_t)k) {
+            return max + 1;
+        }
+
+        std::swap(before, above);
+        std::swap(above, current);
+    }
+
+    const size_t distance = above[m + 1];
+    return distance > (size_t)max ? max + 1 : (long long)distance;
+}
+
+/*
+    osa_banded_cells with the narrowest cell type that fits. Most strings in a
+    database column are short, and a byte per cell instead of eight keeps all three
+    rows in L1 far longer.
+*/
+template <typename Char>
+long long osa_banded(std::basic_string_view<Char> a, std::basic_string_view<Char> b,
+                     long long max, OsaBuffer &buffer) {
+    // The largest value a cell ever has to hold.
+    const long long top = std::min(max, (long long)std::max(a.length(), b.length())) + 1;
+    if (top <= UINT8_MAX) {
+        return osa_banded_cells(a, b, max, buffer.cells8);
+    } else if (top <= UINT16_MAX) {
+        return osa_banded_cells(a, b, max, buffer.cells16);
+    } else if (top <= UINT32_MAX) {
+        return osa_banded_cells(a, b, max, buffer.cells32);
+    }
+    return osa_banded_cells(a, b, max, buffer.cells64);
+}
+
+/*
+    Computes the smallest distance between `typed` and any prefix of `candidate`, if it
+    is at most `max`, and returns some value greater than `max` otherwise.
+
+    Every prefix of `candidate` ends on a different column of the same matrix, so this
+    is the banded kernel with the whole last row as the target instead of its last
+    cell. The matrix is walked a column of `typed` at a time, for one character of
+    `candidate` after another, and only cells with |i - j| <= max are computed. The
+    candidate is read only until the band has moved past the last row, or two columns
+    in a row are entirely above the limit, so a long candidate costs no more than one
+    of length m + max.
+*/
+template <typename Cell>
+long long osa_prefix_cells(std::string_view candidate, std::string_view typed, long long max,
+                           std::vector<Cell> &buffer) {
+    const long long n = (long long)candidate.length();
+    const long long m = (long long)typed.length();
+    if (0 == m) {
+        return 0;
+    }
+    // Deleting all of `typed` always works, so no cell has to hold more than m + 1.
+    const long long k = std::min(max, m);
+    const Cell inf = (Cell)(k + 1);
+
+    // Cell (i, j) lives at index i + 1 of its column, with `inf` just outside the band.
+    const size_t stride = (size_t)m + 3;
+    if (buffer.size() < 3 * stride) {
+        buffer.resize(3 * stride);
+    }
+    Cell *before = buffer.data();
+    Cell *previous = before + stride;
+    Cell *current = previous + stride;
+
+    const long long first_end = std::min(m, k);
+    previous[0] = inf;
+    for (long long i = 0; i <= first_end; ++i) {
+        previous[i + 1] = (Cell)i;
+    }
+    previous[first_end + 2] = inf;
+    // The empty prefix.
+    size_t best = m <= k ? (size_t)m : inf;
+
+    bool hopeless = false;
+    const long long j_end = std::min(n, m + k);
+    for (long long j = 1; j <= j_end; ++j) {
+        const long long i_begin = std::max(0ll, j - k);
+        const long long i_end = std::min(m, j + k);
+        const char c_j = candidate[j - 1];
+        size_t column_min = inf;
+        current[i_begin] = inf;
+        long long i = i_begin;
+        // Row 0, if it is still in the band.
+        if (0 == i) {
+            current[1] = (Cell)std::min(j, k + 1);
+            column_min = current[1];
+            ++i;
+        }
+
+        for (; i <= i_end; ++i) {
+            const size_t cost = typed[i - 1] == c_j ? 0 : 1;
+            size_t value = std::min({(size_t)previous[i + 1] + 1,  // D[i][j-1]
+                                     (size_t)current[i] + 1,       // D[i-1][j]
+                                     (size_t)previous[i] + cost}); // D[i-1][j-1]
+            if (i > 1 && j > 1 && typed[i - 1] == candidate[j - 2] && typed[i - 2] == c_j) {
+                value = std::min(value, (size_t)before[i - 1] + cost); // D[i-2][j-2]
+            }
+            value = std::min(value, (size_t)inf);
+            current[i + 1] = (Cell)value;
+            column_min = std::min(column_min, value);
+        }
+        current[i_end + 2] = inf;
+
+        if (i_end == m) {
+            best = std::min(best, (size_t)current[m + 1]);
+        }
+        // Column minima never decrease, even across a transposition, which skips one
+        // column but not two. So once two columns in a row are above the limit, no
+        // longer prefix can do better.
+        if (column_min > (size_t)k) {
+            if (hopeless) {
+                break;
+            }
+            hopeless = true;
+        } else {
+            hopeless = false;
+        }
+
+        std::swap(before, previous);
+        std::swap(previous, current);
+    }
+
+    return best > (size_t)max ? max + 1 : (long long)best;
+}
+
+// osa_prefix_cells with the narrowest cell type that fits.
+inline long long osa_prefix(std::string_view candidate, std::string_view typed, long long max,
+                            OsaBuffer &buffer) {
+    // The largest value a cell ever has to hold.
+    const long long top = std::min(max, (long long)typed.length()) + 1;
+    if (top <= UINT8_MAX) {
+        return osa_prefix_cells(candidate, typed, max, buffer.cells8);
+    } else if (top <= UINT16_MAX) {
+        return osa_prefix_cells(candidate, typed, max, buffer.cells16);
+    } else if (top <= UINT32_MAX) {
+        return osa_prefix_cells(candidate, typed, max, buffer.cells32);
+    }
+    return osa_prefix_cells(candidate, typed, max, buffer.cells64);
+}
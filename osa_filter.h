@@ -0,0 +1,196 @@
+/*
+    Lower bounds on the optimal string alignment distance, for rejecting rows before
+    any kernel runs.
+
+    In a scan like `WHERE DAMLEVCONST(Name, ?, 3) < 3` almost every row is far from
+    the pattern, and even the bit-parallel kernels read all of it before they find
+    out. Three bounds that never look at an alignment throw most of them out first,
+    cheapest first:
+
+    * The length difference, which every alignment has to insert or delete.
+    * The bag distance: each edit changes the count of at most one character on
+      each side, and a transposition changes none, so the larger of the two
+      surpluses of character counts is a lower bound. The counts are a 256-bin
+      histogram, summed a vector at a time by osa_histogram_surplus.
+    * The q-gram count: an edit destroys at most q + 1 of the q-grams of each string
+      (a transposition of two characters touches q + 1 windows), so with `u` of one
+      string's q-grams missing from the other's, at least u / (q + 1) edits are needed.
+      Bigrams are hashed into OSA_FILTER_BUCKETS buckets. A collision can only make
+      more of them look shared, so the bound stays a lower bound.
+
+    The pattern is compiled once, for DAMLEVCONST. For DAMLEVLIM, where it changes
+    from row to row, each stage adds just the part of it it needs and takes it out
+    again afterwards, so a row the bag distance rejects never hashes a bigram.
+
+    Build with OSA_FILTER_STATS defined to count the rows each stage rejects in
+    osa_filter_stats. The counters are not atomic, so this is for the benchmark only.
+
+    Released under the MIT license. See LICENSE.txt.
+*/
+
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+#include "osa_simd.h"
+
+// Bigram hash buckets. Small enough that the tables stay in L1.
+constexpr size_t OSA_FILTER_BUCKETS = 1024;
+// The length of the q-grams, and how many of them one edit can destroy.
+constexpr long long OSA_FILTER_Q = 2;
+constexpr long long OSA_FILTER_GRAMS_PER_EDIT = OSA_FILTER_Q + 1;
+
+#ifdef OSA_FILTER_STATS
+// Rows seen, and rows rejected by each stage.
+struct OsaFilterStats {
+    unsigned long long rows;
+    unsigned long long length;
+    unsigned long long bag;
+    unsigned long long qgram;
+};
+inline OsaFilterStats osa_filter_stats{};
+#define OSA_FILTER_COUNT(stage) (++osa_filter_stats.stage)
+#else
+#define OSA_FILTER_COUNT(stage) ((void)0)
+#endif
+
+struct OsaFilter {
+    // Character counts of the pattern.
+    int32_t histogram[256];
+    // Hashed bigram counts of the pattern, and how many of each a row has used up.
+    uint32_t grams[OSA_FILTER_BUCKETS];
+    uint32_t used[OSA_FILTER_BUCKETS];
+    size_t length;
+
+    OsaFilter() : histogram(), grams(), used(), length(0) {}
+};
+
+inline size_t osa_filter_bucket(const char *gram) {
+    const uint32_t pair = (uint32_t)(unsigned char)gram[0] << 8 | (unsigned char)gram[1];
+    return (pair * 2654435761u) >> 22;
+}
+
+// Adds `pattern` to a filter that holds no other.
+inline void osa_filter_compile(OsaFilter &filter, std::string_view pattern) {
+    for (const char c : pattern) {
+        ++filter.histogram[(unsigned char)c];
+    }
+    for (size_t i = 0; i + OSA_FILTER_Q <= pattern.length(); ++i) {
+        ++filter.grams[osa_filter_bucket(pattern.data() + i)];
+    }
+    filter.length = pattern.length();
+}
+
+// The bag distance between the pattern and `text`.
+inline long long osa_bag_bound(OsaFilter &filter, std::string_view text) {
+    // Counting `text` down leaves the pattern's surplus positive and its own
+    // negative, and the two differ by the difference in length.
+    for (const char c : text) {
+        --filter.histogram[(unsigned char)c];
+    }
+    const long long surplus = (long long)osa_histogram_surplus(filter.histogram, 256);
+    for (const char c : text) {
+        ++filter.histogram[(unsigned char)c];
+    }
+    return std::max(surplus, surplus - (long long)filter.length + (long long)text.length());
+}
+
+// The q-gram lower bound between the pattern and `text`.
+inline long long osa_qgram_bound(OsaFilter &filter, std::string_view text) {
+    if (text.length() < OSA_FILTER_Q || filter.length < OSA_FILTER_Q) {
+        return 0;
+    }
+    long long shared = 0;
+    for (size_t i = 0; i + OSA_FILTER_Q <= text.length(); ++i) {
+        const size_t bucket = osa_filter_bucket(text.data() + i);
+        if (filter.used[bucket] < filter.grams[bucket]) {
+            ++filter.used[bucket];
+            ++shared;
+        }
+    }
+    for (size_t i = 0; i + OSA_FILTER_Q <= text.length(); ++i) {
+        filter.used[osa_filter_bucket(text.data() + i)] = 0;
+    }
+    const long long grams = (long long)(std::max(text.length(), filter.length) - OSA_FILTER_Q + 1);
+    return (grams - shared + OSA_FILTER_GRAMS_PER_EDIT - 1) / OSA_FILTER_GRAMS_PER_EDIT;
+}
+
+/*
+    Returns whether the distance between the pattern and `text` is certainly greater
+    than `max`, trying the bounds cheapest first.
+*/
+inline bool osa_filter_rejects(OsaFilter &filter, std::string_view text, long long max) {
+    OSA_FILTER_COUNT(rows);
+    const size_t longer = std::max(text.length(), filter.length);
+    if ((long long)(longer - std::min(text.length(), filter.length)) > max) {
+        OSA_FILTER_COUNT(length);
+        return true;
+    }
+    // Neither bound can be more than the longer length.
+    if ((long long)longer <= max) {
+        return false;
+    }
+    if (osa_bag_bound(filter, text) > max) {
+        OSA_FILTER_COUNT(bag);
+        return true;
+    }
+    if (osa_qgram_bound(filter, text) > max) {
+        OSA_FILTER_COUNT(qgram);
+        return true;
+    }
+    return false;
+}
+
+/*
+    The same, for a `pattern` that is only compared against this one `text`. The
+    filter has to be empty, and is left empty.
+*/
+inline bool osa_filter_rejects(OsaFilter &filter, std::string_view pattern,
+                               std::string_view text, long long max) {
+    OSA_FILTER_COUNT(rows);
+    const size_t longer = std::max(text.length(), pattern.length());
+    if ((long long)(longer - std::min(text.length(), pattern.length())) > max) {
+        OSA_FILTER_COUNT(length);
+        return true;
+    }
+    if ((long long)longer <= max) {
+        return false;
+    }
+    // Count `pattern` up and `text` down, as in osa_bag_bound, and clear just the
+    // bins they touched afterwards.
+    for (const char c : pattern) {
+        ++filter.histogram[(unsigned char)c];
+    }
+    for (const char c : text) {
+        --filter.histogram[(unsigned char)c];
+    }
+    const long long surplus = (long long)osa_histogram_surplus(filter.histogram, 256);
+    for (const char c : pattern) {
+        filter.histogram[(unsigned char)c] = 0;
+    }
+    for (const char c : text) {
+        filter.histogram[(unsigned char)c] = 0;
+    }
+    if (std::max(surplus, surplus - (long long)pattern.length() + (long long)text.length()) > max) {
+        OSA_FILTER_COUNT(bag);
+        return true;
+    }
+
+    for (size_t i = 0; i + OSA_FILTER_Q <= pattern.length(); ++i) {
+        ++filter.grams[osa_filter_bucket(pattern.data() + i)];
+    }
+    filter.length = pattern.length();
+    const long long qgram = osa_qgram_bound(filter, text);
+    for (size_t i = 0; i + OSA_FILTER_Q <= pattern.length(); ++i) {
+        filter.grams[osa_filter_bucket(pattern.data() + i)] = 0;
+    }
+    filter.length = 0;
+    if (qgram > max) {
+        OSA_FILTER_COUNT(qgram);
+        return true;
+    }
+    return false;
+}
@@ -0,0 +1,125 @@
+/*
+    Multi-threaded wavefront over the tiles of osa_tiled.h. See osa_parallel.h.
+
+    Released under the MIT license. See LICENSE.txt.
+*/
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "osa_parallel.h"
+#include "osa_tiled.h"
+
+namespace {
+
+template <typename Cell>
+long long osa_parallel_cells(std::string_view a, std::string_view b, long long max,
+                             unsigned threads) {
+    const OsaTiling<Cell> tiling(a, b, max);
+    const long long strips = tiling.strips();
+    threads = (unsigned)std::min<long long>(threads, strips);
+
+    // One pair of border rows shared by every strip, since the strips take turns on
+    // each tile's columns, but a pair of border columns per strip, since every strip
+    // is somewhere along its row at once.
+    const size_t row_stride = (size_t)tiling.m + 2;
+    const size_t column_stride = (size_t)OSA_TILE_ROWS + 2;
+    std::vector<Cell> rows(2 * row_stride);
+    std::vector<Cell> columns(2 * column_stride * (size_t)strips);
+    Cell *top_before = rows.data();
+    Cell *top = top_before + row_stride;
+    tiling.start(top_before, top);
+
+    // One past the last tile each strip has finished.
+    std::unique_ptr<std::atomic<long long>[]> progress(new std::atomic<long long>[strips]);
+    for (long long s = 0; s < strips; ++s) {
+        progress[s].store(tiling.first_tile(s), std::memory_order_relaxed);
+    }
+    // Set by the first strip whose bottom rows rule out the limit.
+    std::atomic<bool> over(false);
+
+    auto run = [&](unsigned thread) {
+        std::vector<Cell> scratch(3 * ((size_t)OSA_TILE_COLUMNS + 2));
+        for (long long s = thread; s < strips; s += threads) {
+            Cell *left_before = columns.data() + 2 * column_stride * (size_t)s;
+            Cell *left = left_before + column_stride;
+            const long long first = tiling.first_tile(s);
+            const long long last = tiling.last_tile(s);
+            const long long above_last = s > 0 ? tiling.last_tile(s - 1) : 0;
+            size_t strip_bound = tiling.inf;
+            for (long long t = first; t <= last; ++t) {
+                // Wait for the tile above, or for the strip above to be done if it
+                // stops short of this column.
+                if (s > 0) {
+                    const long long needed = std::min(t, above_last) + 1;
+                    while (progress[s - 1].load(std::memory_order_acquire) < needed) {
+                        if (over.load(std::memory_order_relaxed)) {
+                            return;
+                        }
+                        std::this_thread::yield();
+                    }
+                }
+                if (t == first) {
+                    tiling.start_strip(s, top_before, top, left_before, left);
+                }
+                tiling.tile(s, t, top_before, top, left_before, left, scratch.data());
+                // Before the strip below gets to overwrite the rows.
+                strip_bound = std::min(strip_bound,
+                                       tiling.tile_bound(s, t, top_before, top));
+                progress[s].store(t + 1, std::memory_order_release);
+            }
+            if (strip_bound > (size_t)tiling.k) {
+                over.store(true, std::memory_order_relaxed);
+                return;
+            }
+        }
+    };
+
+    std::vector<std::thread> workers;
+    for (unsigned thread = 1; thread < threads; ++thread) {
+        workers.emplace_back(run, thread);
+    }
+    run(0);
+    for (auto &worker : workers) {
+        worker.join();
+    }
+
+    if (over.load()) {
+        return max + 1;
+    }
+    const size_t distance = top[tiling.m + 1];
+    return distance > (size_t)max ? max + 1 : (long long)distance;
+}
+
+}  // namespace
+
+long long osa_parallel(std::string_view a, std::string_view b, long long max,
+                       unsigned threads) {
+    // The distance is symmetric, so keep the borders as short as possible.
+    if (b.length() > a.length()) {
+        std::swap(a, b);
+    }
+    // Every alignment needs at least |n - m| insertions or deletions.
+    if ((long long)(a.length() - b.length()) > max) {
+        return max + 1;
+    }
+    if (b.empty()) {
+        return (long long)a.length();
+    }
+    if (0 == threads) {
+        threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    // The largest value a cell ever has to hold.
+    const long long top = std::min(max, (long long)a.length()) + 1;
+    if (top <= UINT16_MAX) {
+        return osa_parallel_cells<uint16_t>(a, b, max, threads);
+    } else if (top <= UINT32_MAX) {
+        return osa_parallel_cells<uint32_t>(a, b, max, threads);
+    }
+    return osa_parallel_cells<size_t>(a, b, max, threads);
+}
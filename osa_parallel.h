@@ -0,0 +1,27 @@
+/*
+    Multi-threaded optimal string alignment for a single, very large pair of strings.
+
+    This is for the standalone library and tools, not for the UDFs, which MySQL
+    already calls from many connections at once and which stay single-threaded.
+
+    The matrix is tiled as in osa_tiled.h. Tile (s, t) only needs tile (s, t - 1) to
+    its left and tile (s - 1, t) above it, so all the tiles on an anti-diagonal
+    s + t = w can be computed at the same time. Strip s goes to thread s % threads,
+    which works through its tiles from left to right, each one as soon as the strip
+    above has finished the tile over it. Once the pipeline has filled, every thread
+    is busy on its own anti-diagonal of the wavefront.
+
+    Released under the MIT license. See LICENSE.txt.
+*/
+
+#pragma once
+
+#include <string_view>
+
+/*
+    Computes the distance between `a` and `b` if it is at most `max`, and returns some
+    value greater than `max` otherwise, on `threads` threads. A `threads` of 0 uses
+    one per hardware thread.
+*/
+long long osa_parallel(std::string_view a, std::string_view b, long long max,
+                       unsigned threads);
@@ -0,0 +1,236 @@
+/*
+    Edit scripts for the optimal string alignment distance, in linear space.
+
+    Recovering the edits themselves normally means keeping the whole DP matrix, which
+    is n * m cells. Hirschberg's divide-and-conquer only ever keeps a few rows:
+
+        D. S. Hirschberg, "A Linear Space Algorithm for Computing Maximal Common
+        Subsequences", Communications of the ACM 18 (1975).
+
+    The rows of the middle of `a` are computed forwards from the top and backwards
+    from the bottom with the rolling-row kernel, which finds the column where an
+    optimal alignment crosses the middle, and both halves are solved the same way.
+    With transpositions, an alignment can also cross the middle inside a
+    transposition, which takes the last two rows of each pass to spot. That doubles
+    the work of a plain distance computation, but the memory is O(n + m).
+
+    Released under the MIT license. See LICENSE.txt.
+*/
+
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// One edit, as it appears in a script. A transposition covers two characters of each
+// string; every other edit covers at most one.
+enum OsaEdit : char {
+    OSA_EDIT_MATCH = '=',
+    OSA_EDIT_SUBSTITUTE = 'S',
+    OSA_EDIT_INSERT = 'I',
+    OSA_EDIT_DELETE = 'D',
+    OSA_EDIT_TRANSPOSE = 'T',
+};
+
+// Scratch space for osa_script(), reused between calls.
+struct OsaScriptBuffer {
+    // Rolling rows for the kernel.
+    std::vector<size_t> rows;
+    // The last two rows of the forward and the backward pass.
+    std::vector<size_t> forward;
+    std::vector<size_t> backward;
+    // The full matrix of the small subproblems at the bottom of the recursion.
+    std::vector<size_t> matrix;
+};
+
+// Subproblems with at most this many cells are solved with a full matrix.
+constexpr size_t OSA_SCRIPT_MATRIX_CELLS = 4096;
+
+/*
+    Computes the last two rows of the matrix of `a` against `b`, or of the two strings
+    reversed if `Reverse`, into `before_last` and `last`, which need room for
+    b.length() + 1 cells each. `a` has to have at least one character.
+*/
+template <bool Reverse>
+void osa_last_rows(std::string_view a, std::string_view b, std::vector<size_t> &rows,
+                   size_t *before_last, size_t *last) {
+    const size_t n = a.length();
+    const size_t m = b.length();
+    auto at_a = [&](size_t i) { return Reverse ? a[n - 1 - i] : a[i]; };
+    auto at_b = [&](size_t j) { return Reverse ? b[m - 1 - j] : b[j]; };
+
+    const size_t stride = m + 1;
+    if (rows.size() < 3 * stride) {
+        rows.resize(3 * stride);
+    }
+    size_t *before = rows.data();
+    size_t *previous = before + stride;
+    size_t *current = previous + stride;
+
+    for (size_t j = 0; j <= m; ++j) {
+        previous[j] = j;
+    }
+    for (size_t i = 1; i <= n; ++i) {
+        const char c = at_a(i - 1);
+        current[0] = i;
+        for (size_t j = 1; j <= m; ++j) {
+            const size_t cost = c == at_b(j - 1) ? 0 : 1;
+            size_t value = std::min({previous[j] + 1, current[j - 1] + 1,
+                                     previous[j - 1] + cost});
+            if (i > 1 && j > 1 && c == at_b(j - 2) && at_a(i - 2) == at_b(j - 1)) {
+                value = std::min(value, before[j - 2] + cost);
+            }
+            current[j] = value;
+        }
+        std::swap(before, previous);
+        std::swap(previous, current);
+    }
+
+    std::copy(before, before + stride, before_last);
+    std::copy(previous, previous + stride, last);
+}
+
+// Appends the edits of an optimal alignment of two small strings, from a full matrix.
+inline void osa_script_matrix(std::string_view a, std::string_view b,
+                              std::vector<size_t> &matrix, std::vector<OsaEdit> &edits) {
+    const size_t n = a.length();
+    const size_t m = b.length();
+    const size_t stride = m + 1;
+    matrix.resize((n + 1) * stride);
+    auto D = [&](size_t i, size_t j) -> size_t & { return matrix[i * stride + j]; };
+
+    for (size_t j = 0; j <= m; ++j) {
+        D(0, j) = j;
+    }
+    for (size_t i = 1; i <= n; ++i) {
+        D(i, 0) = i;
+        for (size_t j = 1; j <= m; ++j) {
+            const size_t cost = a[i - 1] == b[j - 1] ? 0 : 1;
+            size_t value = std::min({D(i - 1, j) + 1, D(i, j - 1) + 1, D(i - 1, j - 1) + cost});
+            if (i > 1 && j > 1 && a[i - 1] == b[j - 2] && a[i - 2] == b[j - 1]) {
+                value = std::min(value, D(i - 2, j - 2) + cost);
+            }
+            D(i, j) = value;
+        }
+    }
+
+    // Walk back from the corner, then reverse.
+    const size_t first = edits.size();
+    size_t i = n;
+    size_t j = m;
+    while (i > 0 || j > 0) {
+        if (i > 0 && j > 0) {
+            const size_t cost = a[i - 1] == b[j - 1] ? 0 : 1;
+            if (D(i, j) == D(i - 1, j - 1) + cost) {
+                edits.push_back(cost ? OSA_EDIT_SUBSTITUTE : OSA_EDIT_MATCH);
+                --i;
+                --j;
+                continue;
+            }
+            if (i > 1 && j > 1 && a[i - 1] == b[j - 2] && a[i - 2] == b[j - 1] &&
+                D(i, j) == D(i - 2, j - 2) + cost) {
+                edits.push_back(OSA_EDIT_TRANSPOSE);
+                i -= 2;
+                j -= 2;
+                continue;
+            }
+        }
+        if (i > 0 && D(i, j) == D(i - 1, j) + 1) {
+            edits.push_back(OSA_EDIT_DELETE);
+            --i;
+        } else {
+            edits.push_back(OSA_EDIT_INSERT);
+            --j;
+        }
+    }
+    std::reverse(edits.begin() + (std::ptrdiff_t)first, edits.end());
+}
+
+// Appends the edits of an optimal alignment of `a` with `b` to `edits`.
+inline void osa_script(std::string_view a, std::string_view b, OsaScriptBuffer &buffer,
+                       std::vector<OsaEdit> &edits) {
+    const size_t n = a.length();
+    const size_t m = b.length();
+    if (0 == n) {
+        edits.insert(edits.end(), m, OSA_EDIT_INSERT);
+        return;
+    }
+    if (0 == m) {
+        edits.insert(edits.end(), n, OSA_EDIT_DELETE);
+        return;
+    }
+    if (n < 2 || (n + 1) * (m + 1) <= OSA_SCRIPT_MATRIX_CELLS) {
+        osa_script_matrix(a, b, buffer.matrix, edits);
+        return;
+    }
+
+    // forward[j] is the cost of a[0, mid) against b[0, j), one row up in
+    // forward_before; backward[c] is the cost of a[mid, n) against the last c
+    // characters of b, one row down in backward_after.
+    const size_t mid = n / 2;
+    const size_t stride = m + 1;
+    buffer.forward.resize(2 * stride);
+    buffer.backward.resize(2 * stride);
+    osa_last_rows<false>(a.substr(0, mid), b, buffer.rows, buffer.forward.data(),
+                         buffer.forward.data() + stride);
+    osa_last_rows<true>(a.substr(mid), b, buffer.rows, buffer.backward.data(),
+                        buffer.backward.data() + stride);
+    const size_t *forward_before = buffer.forward.data();
+    const size_t *forward = forward_before + stride;
+    const size_t *backward_after = buffer.backward.data();
+    const size_t *backward = backward_after + stride;
+
+    // Either the alignment passes through (mid, j)...
+    size_t best = forward[0] + backward[m];
+    size_t split = 0;
+    bool transposed = false;
+    for (size_t j = 1; j <= m; ++j) {
+        const size_t cost = forward[j] + backward[m - j];
+        if (cost < best) {
+            best = cost;
+            split = j;
+        }
+    }
+    // ...or it swaps a[mid - 1, mid + 1) into b[j - 1, j + 1). Swapping two equal
+    // characters is just two matches through (mid, j), which is covered above.
+    for (size_t j = 1; j + 1 <= m; ++j) {
+        if (a[mid - 1] == b[j] && a[mid] == b[j - 1] && a[mid - 1] != a[mid]) {
+            const size_t cost = forward_before[j - 1] + 1 + backward_after[m - j - 1];
+            if (cost < best) {
+                best = cost;
+                split = j;
+                transposed = true;
+            }
+        }
+    }
+
+    if (transposed) {
+        osa_script(a.substr(0, mid - 1), b.substr(0, split - 1), buffer, edits);
+        edits.push_back(OSA_EDIT_TRANSPOSE);
+        osa_script(a.substr(mid + 1), b.substr(split + 1), buffer, edits);
+    } else {
+        osa_script(a.substr(0, mid), b.substr(0, split), buffer, edits);
+        osa_script(a.substr(mid), b.substr(split), buffer, edits);
+    }
+}
+
+// Writes `edits` as runs, such as "=3 S1 I2 T1 =5", where each count is the number of
+// edits of that kind in a row. Needs at most 3 * edits.size() characters.
+inline void osa_script_runs(const std::vector<OsaEdit> &edits, std::string &out) {
+    out.clear();
+    for (size_t i = 0; i < edits.size();) {
+        size_t run = 1;
+        while (i + run < edits.size() && edits[i + run] == edits[i]) {
+            ++run;
+        }
+        if (!out.empty()) {
+            out.push_back(' ');
+        }
+        out.push_back((char)edits[i]);
+        out += std::to_string(run);
+        i += run;
+    }
+}
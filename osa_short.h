@@ -0,0 +1,107 @@
+/*
+    Optimal string alignment kernels for very short strings, such as SKU codes and
+    surnames.
+
+    For strings of a few bytes, setting up any of the general kernels costs more than
+    the distance itself. Here the shorter string, of at most 16 characters, is the
+    pattern of Hyyrö's bit-parallel recurrence (see bitparallel.h), so a whole column
+    of the matrix is one register. Instead of a table of match masks, the mask for
+    each character of the text is computed on the spot by comparing it against all of
+    the pattern at once in an SSE register. There is one kernel per pattern length, so
+    every mask and shift is a constant and the loop over the text is fully unrolled.
+    Nothing touches the heap.
+
+    Released under the MIT license. See LICENSE.txt.
+*/
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string_view>
+#include <utility>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define OSA_SHORT_SSE2 1
+#else
+#define OSA_SHORT_SSE2 0
+#endif
+
+// Both strings must be at most this long for osa_short_distance.
+constexpr size_t OSA_SHORT_MAX_LENGTH = 16;
+
+// The distance between a pattern of exactly M characters and a text of at most
+// OSA_SHORT_MAX_LENGTH characters.
+template <size_t M>
+inline long long osa_short(const char *pattern, std::string_view text) {
+    static_assert(M > 0 && M <= OSA_SHORT_MAX_LENGTH, "pattern too long");
+    constexpr uint32_t mask = (1u << M) - 1;
+    constexpr uint32_t last = 1u << (M - 1);
+
+    char padded[OSA_SHORT_MAX_LENGTH] = {};
+    std::memcpy(padded, pattern, M);
+#if OSA_SHORT_SSE2
+    const __m128i pattern_lanes = _mm_loadu_si128((const __m128i *)padded);
+#endif
+
+    uint32_t VP = mask;
+    uint32_t VN = 0;
+    uint32_t D0 = 0;
+    uint32_t PM_prev = 0;
+    long long distance = (long long)M;
+
+    const size_t n = text.length();
+#if defined(__GNUC__) && !defined(__clang__)
+#pragma GCC unroll 16
+#endif
+    for (size_t j = 0; j < OSA_SHORT_MAX_LENGTH; ++j) {
+        if (j == n) {
+            break;
+        }
+#if OSA_SHORT_SSE2
+        const uint32_t PM = (uint32_t)_mm_movemask_epi8(
+                _mm_cmpeq_epi8(pattern_lanes, _mm_set1_epi8(text[j]))) & mask;
+#else
+        uint32_t PM = 0;
+        for (size_t i = 0; i < M; ++i) {
+            PM |= (uint32_t)(padded[i] == text[j]) << i;
+        }
+#endif
+
+        const uint32_t TR = (((~D0) & PM) << 1) & PM_prev;
+        D0 = (((PM & VP) + VP) ^ VP) | PM | VN | TR;
+
+        uint32_t HP = VN | ~(D0 | VP);
+        uint32_t HN = D0 & VP;
+        distance += (HP & last) ? 1 : 0;
+        distance -= (HN & last) ? 1 : 0;
+
+        HP = (HP << 1) | 1;
+        HN = HN << 1;
+        VP = HN | ~(D0 | HP);
+        VN = HP & D0;
+        PM_prev = PM;
+    }
+
+    return distance;
+}
+
+/*
+    Computes the distance between `a` and `b`, which must both be non-empty and at
+    most OSA_SHORT_MAX_LENGTH characters long.
+*/
+inline long long osa_short_distance(std::string_view a, std::string_view b) {
+    typedef long long (*Kernel)(const char *pattern, std::string_view text);
+    static constexpr Kernel kernels[OSA_SHORT_MAX_LENGTH] = {
+            osa_short<1>,  osa_short<2>,  osa_short<3>,  osa_short<4>,
+            osa_short<5>,  osa_short<6>,  osa_short<7>,  osa_short<8>,
+            osa_short<9>,  osa_short<10>, osa_short<11>, osa_short<12>,
+            osa_short<13>, osa_short<14>, osa_short<15>, osa_short<16>};
+    // The distance is symmetric, and the shorter string makes the narrower pattern.
+    if (b.length() > a.length()) {
+        std::swap(a, b);
+    }
+    return kernels[b.length() - 1](b.data(), a);
+}
@@ -0,0 +1,511 @@
+/*
+    Vectorised optimal string alignment kernel for medium-length strings.
+
+    Cells on the same anti-diagonal i + j = s only depend on the two diagonals before
+    them (and, for a transposition, the one four back), so a whole run of them can be
+    computed at once. With `b` stored reversed, both strings are read forwards along a
+    diagonal and every operand is a contiguous load. Cells are 8 bits wide when the
+    strings are shorter than 255 characters and 16 bits wide otherwise.
+
+    The kernel is written once with GCC vector extensions and instantiated inside a
+    function per instruction set, each with its own target attribute. The rest of the
+    library is compiled for the baseline architecture, so none of it can end up
+    using instructions the CPU does not have.
+
+    Released under the MIT license. See LICENSE.txt.
+*/
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include "osa_simd.h"
+#include "osa_tiled.h"
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define OSA_HAVE_SIMD 1
+#include <immintrin.h>
+#else
+#define OSA_HAVE_SIMD 0
+#endif
+
+namespace {
+
+typedef long long (*OsaDiagonalKernel)(std::string_view a, std::string_view b,
+                                       OsaBuffer &buffer);
+typedef size_t (*OsaPrefixKernel)(const char *a, const char *b, size_t length);
+typedef bool (*OsaAsciiKernel)(const char *s, size_t length);
+typedef size_t (*OsaMismatchKernel)(const char *a, const char *b, size_t length);
+typedef size_t (*OsaSurplusKernel)(const int32_t *counts, size_t length);
+
+// The kernels for one instruction set.
+struct OsaSimdKernels {
+    const char *name;
+    // For strings shorter than 255 characters, and for everything else.
+    OsaDiagonalKernel narrow;
+    OsaDiagonalKernel wide;
+    // 16-bit cells per vector.
+    size_t lanes;
+    OsaPrefixKernel prefix;
+    OsaAsciiKernel ascii;
+    OsaMismatchKernel mismatches;
+    OsaSurplusKernel surplus;
+};
+
+// Compares eight characters at a time as one word.
+size_t osa_common_prefix_scalar(const char *a, const char *b, size_t length) {
+    size_t i = 0;
+#if defined(__GNUC__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    for (; i + sizeof(uint64_t) <= length; i += sizeof(uint64_t)) {
+        uint64_t x, y;
+        std::memcpy(&x, a + i, sizeof(x));
+        std::memcpy(&y, b + i, sizeof(y));
+        if (x != y) {
+            // The lowest differing byte is the first differing character.
+            return i + (size_t)__builtin_ctzll(x ^ y) / 8;
+        }
+    }
+#endif
+    while (i < length && a[i] == b[i]) {
+        ++i;
+    }
+    return i;
+}
+
+// Tests the top bit of eight characters at a time.
+bool osa_is_ascii_scalar(const char *s, size_t length) {
+    size_t i = 0;
+    uint64_t high = 0;
+    for (; i + sizeof(uint64_t) <= length; i += sizeof(uint64_t)) {
+        uint64_t x;
+        std::memcpy(&x, s + i, sizeof(x));
+        high |= x;
+    }
+    for (; i < length; ++i) {
+        high |= (unsigned char)s[i];
+    }
+    return 0 == (high & 0x8080808080808080ull);
+}
+
+// Counts the differing characters of eight at a time, folding each byte of the
+// difference down to its lowest bit. The multiplication then sums the eight bits
+// into the top byte, without needing a popcount instruction.
+size_t osa_mismatches_scalar(const char *a, const char *b, size_t length) {
+    size_t i = 0;
+    size_t count = 0;
+    for (; i + sizeof(uint64_t) <= length; i += sizeof(uint64_t)) {
+        uint64_t x, y;
+        std::memcpy(&x, a + i, sizeof(x));
+        std::memcpy(&y, b + i, sizeof(y));
+        uint64_t differ = x ^ y;
+        differ |= differ >> 4;
+        differ |= differ >> 2;
+        differ |= differ >> 1;
+        count += (size_t)(((differ & 0x0101010101010101ull) * 0x0101010101010101ull) >> 56);
+    }
+    for (; i < length; ++i) {
+        count += a[i] != b[i] ? 1 : 0;
+    }
+    return count;
+}
+
+size_t osa_histogram_surplus_scalar(const int32_t *counts, size_t length) {
+    size_t total = 0;
+    for (size_t i = 0; i < length; ++i) {
+        total += (size_t)std::max(counts[i], 0);
+    }
+    return total;
+}
+
+#if OSA_HAVE_SIMD
+
+template <typename Cell, size_t Bytes>
+struct OsaVector {
+    // Unaligned, since a diagonal can start anywhere.
+    typedef Cell type __attribute__((vector_size(Bytes), aligned(1)));
+};
+
+/*
+    Computes the full distance between `a` and `b`, which must both be shorter than
+    the largest value a `Cell` can hold. Only valid cells are ever read, and none of
+    them can exceed the longer length, so the lanes past the end of a diagonal are
+    free to wrap around.
+
+    Always inlined, so that it is compiled for the target of whichever wrapper below
+    calls it.
+*/
+template <typename Cell, size_t Bytes>
+__attribute__((always_inline)) inline long long
+osa_diagonal(std::string_view a, std::string_view b, std::vector<Cell> &buffer) {
+    typedef typename OsaVector<Cell, Bytes>::type Vector;
+    constexpr size_t W = Bytes / sizeof(Cell);
+    const size_t n = a.length();
+    const size_t m = b.length();
+    if (0 == n || 0 == m) {
+        return (long long)std::max(n, m);
+    }
+
+    // Layout: a, reversed b, five diagonals of distances (s - 4 to s) and two of
+    // match masks (s - 1 and s). Each is padded by a vector so that the lanes past
+    // the end of a diagonal stay inside the buffer. Diagonals are indexed by i and
+    // start two cells in, since the transposition term reads index i - 2.
+    const size_t diagonal = n + W + 3;
+    const size_t total = (n + W) + (m + W) + 7 * diagonal;
+    if (buffer.size() < total) {
+        buffer.resize(total);
+    }
+    std::fill(buffer.begin(), buffer.begin() + total, Cell(0));
+    Cell *a_cells = buffer.data();
+    Cell *b_reversed = a_cells + n + W;
+    for (size_t i = 0; i < n; ++i) {
+        a_cells[i] = (Cell)(unsigned char)a[i];
+    }
+    for (size_t j = 0; j < m; ++j) {
+        b_reversed[j] = (Cell)(unsigned char)b[m - 1 - j];
+    }
+    Cell *d[5];
+    for (size_t k = 0; k < 5; ++k) {
+        d[k] = b_reversed + m + W + k * diagonal + 2;
+    }
+    Cell *match = b_reversed + m + W + 5 * diagonal + 2;
+    Cell *match_above = match + diagonal;
+
+    const Vector one = Vector{} + 1;
+
+    // d[0] is diagonal s, d[1] is s - 1, and so on. Diagonal 0 is the single cell
+    // D[0][0] = 0, which the fill above already took care of.
+    for (size_t s = 1; s <= n + m; ++s) {
+        std::rotate(d, d + 4, d + 5);
+        std::swap(match, match_above);
+
+        // Cells (i, s - i) with 1 <= i <= n and 1 <= s - i <= m.
+        const size_t i_begin = s > m ? s - m : 1;
+        const size_t i_end = std::min(n, s - 1);
+        for (size_t i = i_begin; i <= i_end; i += W) {
+            const Vector eq = (Vector)(*(const Vector *)(a_cells + i - 1)
+                                       == *(const Vector *)(b_reversed + m - s + i));
+            const Vector cost = ~eq & one;
+            const Vector up = *(const Vector *)(d[1] + i - 1) + one;   // D[i-1][j]
+            const Vector left = *(const Vector *)(d[1] + i) + one;     // D[i][j-1]
+            const Vector diag = *(const Vector *)(d[2] + i - 1) + cost; // D[i-1][j-1]
+            Vector value = up < left ? up : left;
+            value = diag < value ? diag : value;
+
+            // a[i-1] == b[j-2] and a[i-2] == b[j-1] are the matches at (i, j - 1)
+            // and (i - 1, j), both on the previous diagonal. Where either is
+            // missing the candidate is forced to the largest cell value.
+            const Vector swapped = *(const Vector *)(match_above + i)
+                                   & *(const Vector *)(match_above + i - 1);
+            const Vector transposition =
+                    (*(const Vector *)(d[4] + i - 2) + cost) | ~swapped; // D[i-2][j-2]
+            value = transposition < value ? transposition : value;
+
+            *(Vector *)(d[0] + i) = value;
+            *(Vector *)(match + i) = eq;
+        }
+
+        // The borders of the matrix, written after the loop since its last vector
+        // may have run over them. They never match anything.
+        if (s <= m) {
+            d[0][0] = (Cell)s;
+        }
+        match[0] = 0;
+        if (s <= n) {
+            d[0][s] = (Cell)s;
+            match[s] = 0;
+        }
+    }
+
+    return (long long)d[0][n];
+}
+
+__attribute__((target("sse4.2"))) long long
+osa_diagonal_sse42_narrow(std::string_view a, std::string_view b, OsaBuffer &buffer) {
+    return osa_diagonal<uint8_t, 16>(a, b, buffer.cells8);
+}
+
+__attribute__((target("sse4.2"))) long long
+osa_diagonal_sse42_wide(std::string_view a, std::string_view b, OsaBuffer &buffer) {
+    return osa_diagonal<uint16_t, 16>(a, b, buffer.cells16);
+}
+
+__attribute__((target("avx2"))) long long
+osa_diagonal_avx2_narrow(std::string_view a, std::string_view b, OsaBuffer &buffer) {
+    return osa_diagonal<uint8_t, 32>(a, b, buffer.cells8);
+}
+
+__attribute__((target("avx2"))) long long
+osa_diagonal_avx2_wide(std::string_view a, std::string_view b, OsaBuffer &buffer) {
+    return osa_diagonal<uint16_t, 32>(a, b, buffer.cells16);
+}
+
+__attribute__((target("avx512bw"))) long long
+osa_diagonal_avx512bw_narrow(std::string_view a, std::string_view b, OsaBuffer &buffer) {
+    return osa_diagonal<uint8_t, 64>(a, b, buffer.cells8);
+}
+
+__attribute__((target("avx512bw"))) long long
+osa_diagonal_avx512bw_wide(std::string_view a, std::string_view b, OsaBuffer &buffer) {
+    return osa_diagonal<uint16_t, 64>(a, b, buffer.cells16);
+}
+
+__attribute__((target("sse4.2"))) size_t
+osa_common_prefix_sse42(const char *a, const char *b, size_t length) {
+    size_t i = 0;
+    for (; i + 16 <= length; i += 16) {
+        const unsigned equal = (unsigned)_mm_movemask_epi8(
+                _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)(a + i)),
+                               _mm_loadu_si128((const __m128i *)(b + i))));
+        if (0xffffu != equal) {
+            return i + (size_t)__builtin_ctz(~equal);
+        }
+    }
+    return i + osa_common_prefix_scalar(a + i, b + i, length - i);
+}
+
+__attribute__((target("avx2"))) size_t
+osa_common_prefix_avx2(const char *a, const char *b, size_t length) {
+    size_t i = 0;
+    for (; i + 32 <= length; i += 32) {
+        const unsigned equal = (unsigned)_mm256_movemask_epi8(
+                _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i *)(a + i)),
+                                  _mm256_loadu_si256((const __m256i *)(b + i))));
+        if (0xffffffffu != equal) {
+            return i + (size_t)__builtin_ctz(~equal);
+        }
+    }
+    return i + osa_common_prefix_scalar(a + i, b + i, length - i);
+}
+
+__attribute__((target("avx512bw"))) size_t
+osa_common_prefix_avx512bw(const char *a, const char *b, size_t length) {
+    size_t i = 0;
+    for (; i + 64 <= length; i += 64) {
+        const uint64_t differ = _mm512_cmpneq_epi8_mask(_mm512_loadu_si512(a + i),
+                                                        _mm512_loadu_si512(b + i));
+        if (0 != differ) {
+            return i + (size_t)__builtin_ctzll(differ);
+        }
+    }
+    return i + osa_common_prefix_scalar(a + i, b + i, length - i);
+}
+
+__attribute__((target("sse4.2"))) bool osa_is_ascii_sse42(const char *s, size_t length) {
+    size_t i = 0;
+    __m128i high = _mm_setzero_si128();
+    for (; i + 16 <= length; i += 16) {
+        high = _mm_or_si128(high, _mm_loadu_si128((const __m128i *)(s + i)));
+    }
+    return 0 == _mm_movemask_epi8(high) && osa_is_ascii_scalar(s + i, length - i);
+}
+
+__attribute__((target("avx2"))) bool osa_is_ascii_avx2(const char *s, size_t length) {
+    size_t i = 0;
+    __m256i high = _mm256_setzero_si256();
+    for (; i + 32 <= length; i += 32) {
+        high = _mm256_or_si256(high, _mm256_loadu_si256((const __m256i *)(s + i)));
+    }
+    return 0 == _mm256_movemask_epi8(high) && osa_is_ascii_scalar(s + i, length - i);
+}
+
+__attribute__((target("avx512bw"))) bool osa_is_ascii_avx512bw(const char *s, size_t length) {
+    size_t i = 0;
+    __m512i high = _mm512_setzero_si512();
+    for (; i + 64 <= length; i += 64) {
+        high = _mm512_or_si512(high, _mm512_loadu_si512(s + i));
+    }
+    return 0 == _mm512_movepi8_mask(high) && osa_is_ascii_scalar(s + i, length - i);
+}
+
+__attribute__((target("sse4.2,popcnt"))) size_t
+osa_mismatches_sse42(const char *a, const char *b, size_t length) {
+    size_t i = 0;
+    size_t count = 0;
+    for (; i + 16 <= length; i += 16) {
+        const unsigned equal = (unsigned)_mm_movemask_epi8(
+                _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i *)(a + i)),
+                               _mm_loadu_si128((const __m128i *)(b + i))));
+        count += 16 - (size_t)__builtin_popcount(equal);
+    }
+    return count + osa_mismatches_scalar(a + i, b + i, length - i);
+}
+
+__attribute__((target("avx2,popcnt"))) size_t
+osa_mismatches_avx2(const char *a, const char *b, size_t length) {
+    size_t i = 0;
+    size_t count = 0;
+    for (; i + 32 <= length; i += 32) {
+        const unsigned equal = (unsigned)_mm256_movemask_epi8(
+                _mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i *)(a + i)),
+                                  _mm256_loadu_si256((const __m256i *)(b + i))));
+        count += 32 - (size_t)__builtin_popcount(equal);
+    }
+    return count + osa_mismatches_scalar(a + i, b + i, length - i);
+}
+
+__attribute__((target("avx512bw,popcnt"))) size_t
+osa_mismatches_avx512bw(const char *a, const char *b, size_t length) {
+    size_t i = 0;
+    size_t count = 0;
+    for (; i + 64 <= length; i += 64) {
+        count += (size_t)__builtin_popcountll(_mm512_cmpneq_epi8_mask(
+                _mm512_loadu_si512(a + i), _mm512_loadu_si512(b + i)));
+    }
+    return count + osa_mismatches_scalar(a + i, b + i, length - i);
+}
+
+// The lanes can not overflow, since they add up to no more than the pattern length.
+__attribute__((target("sse4.2"))) size_t
+osa_histogram_surplus_sse42(const int32_t *counts, size_t length) {
+    size_t i = 0;
+    __m128i total = _mm_setzero_si128();
+    for (; i + 4 <= length; i += 4) {
+        total = _mm_add_epi32(total, _mm_max_epi32(_mm_loadu_si128((const __m128i *)(counts + i)),
+                                                   _mm_setzero_si128()));
+    }
+    total = _mm_add_epi32(total, _mm_shuffle_epi32(total, 0x4e));
+    total = _mm_add_epi32(total, _mm_shuffle_epi32(total, 0xb1));
+    return (size_t)(uint32_t)_mm_cvtsi128_si32(total) +
+           osa_histogram_surplus_scalar(counts + i, length - i);
+}
+
+__attribute__((target("avx2"))) size_t
+osa_histogram_surplus_avx2(const int32_t *counts, size_t length) {
+    size_t i = 0;
+    __m256i total = _mm256_setzero_si256();
+    for (; i + 8 <= length; i += 8) {
+        total = _mm256_add_epi32(total,
+                                 _mm256_max_epi32(_mm256_loadu_si256((const __m256i *)(counts + i)),
+                                                  _mm256_setzero_si256()));
+    }
+    __m128i half = _mm_add_epi32(_mm256_castsi256_si128(total),
+                                 _mm256_extracti128_si256(total, 1));
+    half = _mm_add_epi32(half, _mm_shuffle_epi32(half, 0x4e));
+    half = _mm_add_epi32(half, _mm_shuffle_epi32(half, 0xb1));
+    return (size_t)(uint32_t)_mm_cvtsi128_si32(half) +
+           osa_histogram_surplus_scalar(counts + i, length - i);
+}
+
+__attribute__((target("avx512bw"))) size_t
+osa_histogram_surplus_avx512bw(const int32_t *counts, size_t length) {
+    size_t i = 0;
+    __m512i total = _mm512_setzero_si512();
+    for (; i + 16 <= length; i += 16) {
+        total = _mm512_add_epi32(total, _mm512_maskz_max_epi32(0xffff, _mm512_loadu_si512(counts + i),
+                                                               _mm512_setzero_si512()));
+    }
+    // The zero-masking forms, because GCC 12 builds the plain ones on an undefined
+    // vector and warns about it. All lanes are selected, so they compile the same.
+    const __m256i quarter = _mm256_add_epi32(_mm512_maskz_extracti64x4_epi64(0xff, total, 0),
+                                             _mm512_maskz_extracti64x4_epi64(0xff, total, 1));
+    __m128i half = _mm_add_epi32(_mm256_castsi256_si128(quarter),
+                                 _mm256_extracti128_si256(quarter, 1));
+    half = _mm_add_epi32(half, _mm_shuffle_epi32(half, 0x4e));
+    half = _mm_add_epi32(half, _mm_shuffle_epi32(half, 0xb1));
+    return (size_t)(uint32_t)_mm_cvtsi128_si32(half) +
+           osa_histogram_surplus_scalar(counts + i, length - i);
+}
+
+#endif // OSA_HAVE_SIMD
+
+OsaSimdKernels osa_simd_select() {
+#if OSA_HAVE_SIMD
+    // Needed because this runs while the library is being loaded, possibly before
+    // libgcc has set up the CPU model itself.
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512bw")) {
+        return {"AVX-512BW", osa_diagonal_avx512bw_narrow, osa_diagonal_avx512bw_wide, 32,
+                osa_common_prefix_avx512bw, osa_is_ascii_avx512bw, osa_mismatches_avx512bw,
+                osa_histogram_surplus_avx512bw};
+    } else if (__builtin_cpu_supports("avx2")) {
+        return {"AVX2", osa_diagonal_avx2_narrow, osa_diagonal_avx2_wide, 16,
+                osa_common_prefix_avx2, osa_is_ascii_avx2, osa_mismatches_avx2,
+                osa_histogram_surplus_avx2};
+    } else if (__builtin_cpu_supports("sse4.2")) {
+        return {"SSE4.2", osa_diagonal_sse42_narrow, osa_diagonal_sse42_wide, 8,
+                osa_common_prefix_sse42, osa_is_ascii_sse42, osa_mismatches_sse42,
+                osa_histogram_surplus_sse42};
+    }
+#endif
+    return {"scalar", nullptr, nullptr, 0, osa_common_prefix_scalar, osa_is_ascii_scalar,
+            osa_mismatches_scalar, osa_histogram_surplus_scalar};
+}
+
+// Resolved once, when the library is loaded.
+const OsaSimdKernels osa_simd = osa_simd_select();
+
+} // namespace
+
+long long osa_upper_bound(std::string_view a, std::string_view b) {
+    const size_t shorter = std::min(a.length(), b.length());
+    const size_t difference = std::max(a.length(), b.length()) - shorter;
+    const size_t head = osa_simd.mismatches(a.data(), b.data(), shorter);
+    if (0 == difference || 0 == head) {
+        return (long long)(difference + head);
+    }
+    const size_t tail = osa_simd.mismatches(a.data() + a.length() - shorter,
+                                            b.data() + b.length() - shorter, shorter);
+    return (long long)(difference + std::min(head, tail));
+}
+
+/*
+    Inside the medium length range the vectorised kernel costs about n*m/lanes steps
+    however similar the strings are, while the banded kernel costs n*k scalar steps
+    and gives up quickly on dissimilar strings. So a narrow band, worth about as much
+    as one pass of the vectorised kernel, is tried first and near-duplicates never
+    reach it.
+
+    Before any of that, osa_upper_bound caps the band: near-duplicates with a few
+    substitutions get a band only as wide as their Hamming distance, and when the
+    bound is the length difference, which every alignment needs, it is the distance.
+*/
+long long osa_distance(std::string_view a, std::string_view b, OsaBuffer &buffer) {
+    const size_t shorter = std::min(a.length(), b.length());
+    const size_t longer = std::max(a.length(), b.length());
+    const long long bound = osa_upper_bound(a, b);
+    if (bound <= (long long)(longer - shorter)) {
+        return bound;
+    }
+    if (nullptr != osa_simd.narrow && shorter >= OSA_SIMD_MIN_LENGTH
+        && longer <= OSA_SIMD_MAX_LENGTH) {
+        const long long probe = (long long)(shorter / osa_simd.lanes);
+        if (bound <= probe) {
+            // The distance is at most the bound, so a band that wide proves it.
+            return osa_banded(a, b, bound, buffer);
+        }
+        if ((long long)(longer - shorter) <= probe) {
+            const long long distance = osa_banded(a, b, probe, buffer);
+            if (distance <= probe) {
+                return distance;
+            }
+        }
+        if (longer < UINT8_MAX) {
+            return osa_simd.narrow(a, b, buffer);
+        }
+        return osa_simd.wide(a, b, buffer);
+    }
+    return osa_doubling(a, b, buffer, bound);
+}
+
+bool osa_simd_beats_band(size_t shorter, size_t longer, long long k) {
+    // The same trade-off as the probe in osa_distance.
+    return nullptr != osa_simd.narrow && shorter >= OSA_SIMD_MIN_LENGTH &&
+           longer <= OSA_SIMD_MAX_LENGTH && k > (long long)(shorter / osa_simd.lanes);
+}
+
+size_t osa_common_prefix(const char *a, const char *b, size_t length) {
+    return osa_simd.prefix(a, b, length);
+}
+
+bool osa_is_ascii(const char *s, size_t length) {
+    return osa_simd.ascii(s, length);
+}
+
+size_t osa_histogram_surplus(const int32_t *counts, size_t length) {
+    return osa_simd.surplus(counts, length);
+}
+
+const char *osa_simd_name() {
+    return osa_simd.name;
+}
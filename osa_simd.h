@@ -0,0 +1,69 @@
+/*
+    Vectorised optimal string alignment kernel for medium-length strings.
+
+    The kernel is built for several instruction sets (SSE4.2, AVX2 and AVX-512BW on
+    x86) in one binary. The best one the CPU supports is picked once, when the
+    library is loaded, so the plugin runs on older machines and still makes use of
+    newer ones. Without any of them, everything runs on the scalar kernels in osa.h.
+
+    The same goes for osa_common_prefix, which the diagonal-transition kernel in
+    osa_transition.h spends most of its time in, for osa_is_ascii, which keeps plain
+    ASCII on the byte kernels in UTF-8 mode, for the mismatch count behind
+    osa_upper_bound, and for the histogram sums of the filters in osa_filter.h.
+
+    Released under the MIT license. See LICENSE.txt.
+*/
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string_view>
+
+#include "osa.h"
+
+// The range of lengths, after trimming, the vectorised kernel is used for. Below
+// it a row fits in a couple of registers and the scalar kernels win; above it the
+// cells no longer fit in L2.
+constexpr size_t OSA_SIMD_MIN_LENGTH = 64;
+constexpr size_t OSA_SIMD_MAX_LENGTH = 2000;
+
+/*
+    Computes the distance between `a` and `b` with no limit. This is the entry point
+    for the UDFs that do not take one.
+*/
+long long osa_distance(std::string_view a, std::string_view b, OsaBuffer &buffer);
+
+/*
+    Returns the number of leading characters `a` and `b` have in common, looking at
+    no more than `length` of them. Compares a whole vector of characters at a time.
+*/
+size_t osa_common_prefix(const char *a, const char *b, size_t length);
+
+// Returns whether none of the first `length` characters of `s` has its top bit set,
+// so that a UTF-8 string is one byte per code point. Checks a whole vector at a time.
+bool osa_is_ascii(const char *s, size_t length);
+
+/*
+    Returns an upper bound on the distance between `a` and `b`, from the cheaper of
+    two alignments that never leave a diagonal: the shorter string lined up with the
+    start of the longer one, and with its end, with the rest of the longer one
+    inserted. For strings of the same length that is their Hamming distance. Counts a
+    whole vector of mismatches at a time.
+
+    The kernels only ever need a band as wide as the bound, and a bound equal to the
+    length difference is the distance itself.
+*/
+long long osa_upper_bound(std::string_view a, std::string_view b);
+
+// Returns whether the vectorised kernel computes the whole distance between strings
+// of these lengths faster than the banded kernels can with a band of `k`.
+bool osa_simd_beats_band(size_t shorter, size_t longer, long long k);
+
+// Returns the sum of the positive entries of `counts`, a whole vector of them at a
+// time. The character histograms of osa_filter.h are reduced with it.
+size_t osa_histogram_surplus(const int32_t *counts, size_t length);
+
+// The name of the instruction set the vectorised kernel was selected for, or
+// "scalar" if there is none.
+const char *osa_simd_name();
@@ -0,0 +1,324 @@
+/*
+    Cache-blocked optimal string alignment kernel for long strings that are far apart.
+
+    The banded kernel in osa.h walks the matrix a row at a time. Once the band is tens
+    of thousands of cells wide, its three rows no longer fit in cache, and every cell
+    costs a trip to memory. Here the matrix is cut into tiles of OSA_TILE_ROWS by
+    OSA_TILE_COLUMNS cells instead, whose rows stay in L1 while the tile is computed.
+    Between tiles only their borders are kept: the bottom two rows of each strip of
+    tiles, as long as the shorter string, and the right two columns of the tile to the
+    left, as tall as a strip. Memory is O(n + m), and each cell of the borders goes
+    through memory once per strip instead of once per row.
+
+    The borders are two cells thick because the transposition term looks two rows up
+    and two columns left, which from the first row or column of a tile lands in the
+    tile above or to the left.
+
+    Released under the MIT license. See LICENSE.txt.
+*/
+
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <string_view>
+#include <vector>
+
+#include "osa.h"
+
+// Rows of a tile, and the height of a strip of tiles.
+constexpr long long OSA_TILE_ROWS = 256;
+// Columns of a tile. Three rows of this many cells, and the characters they cover,
+// fit in L1.
+constexpr long long OSA_TILE_COLUMNS = 1024;
+// Bands at least this wide go to the tiled kernel.
+constexpr long long OSA_TILED_MIN_BAND = 2048;
+
+/*
+    The geometry of one tiled comparison, and the steps it is made of. The matrix is
+    cut into strips of OSA_TILE_ROWS rows, and each strip into tiles of
+    OSA_TILE_COLUMNS columns; tile t of a strip covers columns j0 + 1 to
+    j0 + OSA_TILE_COLUMNS, with j0 = t * OSA_TILE_COLUMNS.
+
+    Rows are indexed by column, with column j at index j + 1. Columns are indexed by
+    row within the strip, with row i0 + r at index r + 1. A tile reads the two rows
+    above it from `top_before` and `top` and overwrites them with its own bottom two
+    rows. It reads the two columns to its left from `left_before` and `left` and
+    overwrites them with its own rightmost two, for the tile to its right.
+
+    Only the tiles that overlap Ukkonen's band are computed, and cells are capped at
+    k + 1, as in the banded kernel.
+*/
+template <typename Cell>
+struct OsaTiling {
+    // `a` is the longer string, and runs down the rows.
+    std::string_view a;
+    std::string_view b;
+    long long n;
+    long long m;
+    long long d;
+    long long k;
+    // Cell (i, j) is in the band if i + lo <= j <= i + hi.
+    long long lo;
+    long long hi;
+    Cell inf;
+
+    // The caller has checked that |n - m| <= max and that neither string is empty.
+    OsaTiling(std::string_view a, std::string_view b, long long max)
+            : a(a), b(b), n((long long)a.length()), m((long long)b.length()), d(m - n),
+              k(std::min(max, n)), lo(std::max(-k, d - k)), hi(std::min(k, d + k)),
+              inf((Cell)(k + 1)) {}
+
+    bool in_band(long long i, long long j) const {
+        return i >= 0 && j >= 0 && j - i >= lo && j - i <= hi;
+    }
+
+    // The number of strips, and of tiles in a strip, including those outside the band.
+    long long strips() const {
+        return (n + OSA_TILE_ROWS - 1) / OSA_TILE_ROWS;
+    }
+
+    // The first and last tile of strip `s` that overlap the band.
+    long long first_tile(long long s) const {
+        const long long i0 = s * OSA_TILE_ROWS;
+        return (std::max(1ll, i0 + 1 + lo) - 1) / OSA_TILE_COLUMNS;
+    }
+    long long last_tile(long long s) const {
+        const long long i_end = std::min(n, (s + 1) * OSA_TILE_ROWS);
+        return (std::min(m, i_end + hi) - 1) / OSA_TILE_COLUMNS;
+    }
+
+    // Fills in rows -1 and 0. Anything left of or beyond the band is read as `inf`
+    // later, so stale cells from earlier strips never need clearing.
+    void start(Cell *top_before, Cell *top) const {
+        std::fill(top_before, top_before + m + 2, inf);
+        for (long long j = 0; j <= m; ++j) {
+            top[j + 1] = (Cell)j;
+        }
+    }
+
+    // Fills in the two columns left of the first tile of strip `s`. They are outside
+    // the band below the strip above, except for column 0.
+    void start_strip(long long s, const Cell *top_before, const Cell *top,
+                     Cell *left_before, Cell *left) const {
+        const long long i0 = s * OSA_TILE_ROWS;
+        const long long rows = std::min(OSA_TILE_ROWS, n - i0);
+        const long long j0 = first_tile(s) * OSA_TILE_COLUMNS;
+        for (long long r = -1; r <= rows; ++r) {
+            const long long i = i0 + r;
+            left_before[r + 1] = inf;
+            left[r + 1] = in_band(i, 0) && 0 == j0 ? (Cell)i : inf;
+        }
+        if (j0 > 0) {
+            left_before[0] = in_band(i0 - 1, j0 - 1) ? top_before[j0] : inf;
+            left_before[1] = in_band(i0, j0 - 1) ? top[j0] : inf;
+            left[0] = in_band(i0 - 1, j0) ? top_before[j0 + 1] : inf;
+            left[1] = in_band(i0, j0) ? top[j0 + 1] : inf;
+        }
+    }
+
+    // Computes tile t of strip s. `scratch` holds three rows of OSA_TILE_COLUMNS + 2
+    // cells.
+    void tile(long long s, long long t, Cell *top_before, Cell *top, Cell *left_before,
+              Cell *left, Cell *scratch) const {
+        const long long i0 = s * OSA_TILE_ROWS;
+        const long long rows = std::min(OSA_TILE_ROWS, n - i0);
+        const long long j0 = t * OSA_TILE_COLUMNS;
+        const long long columns = std::min(OSA_TILE_COLUMNS, m - j0);
+        const size_t tile_stride = (size_t)OSA_TILE_COLUMNS + 2;
+        // Three rolling rows, with the two columns to the left of the tile.
+        Cell *before = scratch;
+        Cell *above = before + tile_stride;
+        Cell *current = above + tile_stride;
+
+        // The two rows above the tile.
+        before[0] = left_before[0];
+        before[1] = left[0];
+        above[0] = left_before[1];
+        above[1] = left[1];
+        for (long long c = 1; c <= columns; ++c) {
+            const long long j = j0 + c;
+            before[c + 1] = in_band(i0 - 1, j) ? top_before[j + 1] : inf;
+            above[c + 1] = in_band(i0, j) ? top[j + 1] : inf;
+        }
+        left_before[0] = before[columns];
+        left[0] = before[columns + 1];
+        left_before[1] = above[columns];
+        left[1] = above[columns + 1];
+
+        for (long long r = 1; r <= rows; ++r) {
+            const long long i = i0 + r;
+            const char a_i = a[i - 1];
+            // In row 1 and column 1 the transposition looks at row or column -1,
+            // which is all `inf`, so whatever character stands in for the one
+            // before the string makes no difference.
+            const char a_before = i > 1 ? a[i - 2] : 0;
+            char b_before = j0 > 0 ? b[j0 - 1] : 0;
+            current[0] = left_before[r + 1];
+            current[1] = left[r + 1];
+            // D[i][j-1], kept in a register rather than reloaded from the row.
+            size_t previous = current[1];
+            for (long long c = 1; c <= columns; ++c) {
+                const char b_j = b[j0 + c - 1];
+                const size_t cost = a_i == b_j ? 0 : 1;
+                size_t value = std::min({(size_t)above[c + 1] + 1,  // D[i-1][j]
+                                         previous + 1,              // D[i][j-1]
+                                         (size_t)above[c] + cost}); // D[i-1][j-1]
+                // Selected rather than branched on, since on text it is taken at
+                // random.
+                const size_t transposition = (size_t)before[c - 1] + cost; // D[i-2][j-2]
+                const bool transposed = (a_i == b_before) & (a_before == b_j);
+                value = transposed ? std::min(value, transposition) : value;
+                previous = std::min(value, (size_t)inf);
+                current[c + 1] = (Cell)previous;
+                b_before = b_j;
+            }
+            left_before[r + 1] = current[columns];
+            left[r + 1] = current[columns + 1];
+
+            Cell *recycled = before;
+            before = above;
+            above = current;
+            current = recycled;
+        }
+
+        // The bottom two rows of the tile become the top of the one below.
+        for (long long c = 1; c <= columns; ++c) {
+            top_before[j0 + c + 1] = before[c + 1];
+            top[j0 + c + 1] = above[c + 1];
+        }
+    }
+
+    // The cheapest any alignment through the last two rows of strip `s` can end up,
+    // in the columns of tile t, which it has just computed. Neither row minimum ever
+    // decreases, and a transposition can skip one row but not two, so if this is more
+    // than k for every tile of the strip, no later strip can do better.
+    size_t tile_bound(long long s, long long t, const Cell *top_before,
+                      const Cell *top) const {
+        const long long i_end = std::min(n, (s + 1) * OSA_TILE_ROWS);
+        const long long j0 = t * OSA_TILE_COLUMNS;
+        const long long columns = std::min(OSA_TILE_COLUMNS, m - j0);
+        size_t bound = inf;
+        // Column 0 is never stored, since it is always i.
+        if (0 == j0 && in_band(i_end, 0)) {
+            bound = (size_t)(i_end + std::abs(d + i_end));
+        }
+        for (long long j = j0 + 1; j <= j0 + columns; ++j) {
+            if (in_band(i_end - 1, j)) {
+                bound = std::min(bound, (size_t)top_before[j + 1]
+                                        + (size_t)std::abs(d - (j - i_end + 1)));
+            }
+            if (in_band(i_end, j)) {
+                bound = std::min(bound, (size_t)top[j + 1] + (size_t)std::abs(d - (j - i_end)));
+            }
+        }
+        return bound;
+    }
+};
+
+/*
+    Computes the distance between `a` and `b` if it is at most `max`, and returns some
+    value greater than `max` otherwise, one tile at a time.
+*/
+template <typename Cell>
+long long osa_tiled_cells(std::string_view a, std::string_view b, long long max,
+                          std::vector<Cell> &buffer) {
+    // The distance is symmetric, so keep the borders as short as possible.
+    if (b.length() > a.length()) {
+        std::swap(a, b);
+    }
+    // Every alignment needs at least |n - m| insertions or deletions.
+    if ((long long)(a.length() - b.length()) > max) {
+        return max + 1;
+    }
+    if (b.empty()) {
+        return (long long)a.length();
+    }
+    const OsaTiling<Cell> tiling(a, b, max);
+
+    const size_t row_stride = (size_t)tiling.m + 2;
+    const size_t column_stride = (size_t)OSA_TILE_ROWS + 2;
+    const size_t size = 2 * row_stride + 2 * column_stride + 3 * ((size_t)OSA_TILE_COLUMNS + 2);
+    if (buffer.size() < size) {
+        buffer.resize(size);
+    }
+    Cell *top_before = buffer.data();
+    Cell *top = top_before + row_stride;
+    Cell *left_before = top + row_stride;
+    Cell *left = left_before + column_stride;
+    Cell *scratch = left + column_stride;
+
+    tiling.start(top_before, top);
+    for (long long s = 0; s < tiling.strips(); ++s) {
+        tiling.start_strip(s, top_before, top, left_before, left);
+        size_t strip_bound = tiling.inf;
+        for (long long t = tiling.first_tile(s); t <= tiling.last_tile(s); ++t) {
+            tiling.tile(s, t, top_before, top, left_before, left, scratch);
+            strip_bound = std::min(strip_bound, tiling.tile_bound(s, t, top_before, top));
+        }
+        if (strip_bound > (size_t)tiling.k) {
+            return max + 1;
+        }
+    }
+
+    const size_t distance = top[tiling.m + 1];
+    return distance > (size_t)max ? max + 1 : (long long)distance;
+}
+
+// osa_tiled_cells with the narrowest cell type that fits.
+inline long long osa_tiled(std::string_view a, std::string_view b, long long max,
+                           OsaBuffer &buffer) {
+    // The largest value a cell ever has to hold.
+    const long long top = std::min(max, (long long)std::max(a.length(), b.length())) + 1;
+    if (top <= UINT16_MAX) {
+        return osa_tiled_cells(a, b, max, buffer.cells16);
+    } else if (top <= UINT32_MAX) {
+        return osa_tiled_cells(a, b, max, buffer.cells32);
+    }
+    return osa_tiled_cells(a, b, max, buffer.cells64);
+}
+
+/*
+    Computes the distance between `a` and `b` if it is at most `max`, and returns some
+    value greater than `max` otherwise, with the banded kernel while its rows fit in
+    cache and the tiled one after that.
+*/
+inline long long osa_bounded(std::string_view a, std::string_view b, long long max,
+                             OsaBuffer &buffer) {
+    const long long band = 2 * std::min(max, (long long)std::min(a.length(), b.length())) + 1;
+    if (band >= OSA_TILED_MIN_BAND) {
+        return osa_tiled(a, b, max, buffer);
+    }
+    return osa_banded(a, b, max, buffer);
+}
+
+/*
+    Computes the distance between `a` and `b` with no limit, in time proportional to
+    the distance itself rather than to the size of the matrix.
+
+    The kernels are run with k = 1, 2, 4, ... (starting at the length difference,
+    below which they cannot succeed) until the band is wide enough to prove the exact
+    distance. With d the true distance, the last band is less than 2d wide and the
+    earlier ones add up to less than that again, so the total cost is O(n*d).
+
+    `ceiling` is a known upper bound on the distance, which the band never has to
+    grow past; the longer length always is one.
+*/
+inline long long osa_doubling(std::string_view a, std::string_view b,
+                              OsaBuffer &buffer, long long ceiling) {
+    const long long n = (long long)a.length();
+    const long long m = (long long)b.length();
+    ceiling = std::min(ceiling, std::max(n, m));
+
+    long long k = std::max(1ll, std::abs(n - m));
+    while (true) {
+        k = std::min(k, ceiling);
+        const long long distance = osa_bounded(a, b, k, buffer);
+        if (distance <= k || k == ceiling) {
+            return distance;
+        }
+        k *= 2;
+    }
+}
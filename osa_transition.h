@@ -0,0 +1,95 @@
+/*
+    Diagonal-transition (Landau–Vishkin) kernel for the optimal string alignment
+    distance, for long strings that differ by only a few edits.
+
+    Instead of filling in cells, this tracks, for each diagonal d = j - i and each
+    cost e, the furthest row L[e][d] that can be reached on that diagonal with at most
+    e edits. Going from e - 1 to e, each diagonal takes one step from a substitution,
+    deletion, insertion or transposition and then slides down for free for as long as
+    the strings match. The slides are where almost all of the work is for similar
+    strings, and they are done a vector at a time by osa_common_prefix. The total cost
+    is O(k^2) steps plus O((n + m) * k / 32) character comparisons, which for 50 KB
+    documents a few edits apart is a tiny fraction of even the banded kernel.
+
+    Released under the MIT license. See LICENSE.txt.
+*/
+
+#pragma once
+
+#include <algorithm>
+#include <climits>
+#include <cstddef>
+#include <cstdlib>
+#include <string_view>
+#include <vector>
+
+#include "osa_simd.h"
+
+// The kernel is used when the longer string is at least this many times longer than
+// the limit. Below that, the banded and bit-parallel kernels do just as well.
+constexpr long long OSA_TRANSITION_MIN_RATIO = 16;
+
+/*
+    Computes the distance between `a` and `b` if it is at most `max`, and returns some
+    value greater than `max` otherwise. `furthest` is grown as needed and can be
+    reused across calls.
+*/
+inline long long osa_transition(std::string_view a, std::string_view b, long long max,
+                                std::vector<long long> &furthest) {
+    const long long n = (long long)a.length();
+    const long long m = (long long)b.length();
+    // The diagonal (n, m) is on.
+    const long long target = m - n;
+    if (std::abs(target) > max) {
+        return max + 1;
+    }
+
+    // Rows for e - 1 and e, indexed by diagonal from -max - 2 to max + 2 so that the
+    // neighbours of every diagonal in use exist.
+    const long long width = 2 * max + 5;
+    if ((long long)furthest.size() < 2 * width) {
+        furthest.resize(2 * width);
+    }
+    // No row at all yet: any step from it loses to any real row.
+    const long long none = LLONG_MIN / 2;
+    std::fill(furthest.begin(), furthest.begin() + 2 * width, none);
+    long long *above = furthest.data() + max + 2;
+    long long *current = above + width;
+
+    // Follows diagonal d down from row i while the strings match.
+    auto slide = [&](long long d, long long i) {
+        const long long length = std::min(n - i, m - d - i);
+        return i + (long long)osa_common_prefix(a.data() + i, b.data() + d + i, (size_t)length);
+    };
+
+    current[0] = slide(0, 0);
+    for (long long e = 0;; ++e) {
+        if (current[target] >= n) {
+            return e;
+        }
+        if (e == max) {
+            return max + 1;
+        }
+        std::swap(above, current);
+
+        // Diagonals that can still reach the target within the limit.
+        const long long remaining = max - (e + 1);
+        const long long d_begin = std::max({-(e + 1), -n, target - remaining});
+        const long long d_end = std::min({e + 1, m, target + remaining});
+        for (long long d = d_begin; d <= d_end; ++d) {
+            const long long r = above[d];
+            long long i = std::max({r + 1,             // substitution
+                                    above[d + 1] + 1,  // deletion
+                                    above[d - 1]});    // insertion
+            // A transposition of the two characters right after the slide on this
+            // diagonal stopped.
+            if (r >= 0 && r + 1 < n && d + r + 1 < m && a[r] == b[d + r + 1]
+                && a[r + 1] == b[d + r]) {
+                i = std::max(i, r + 2);
+            }
+            // A step off the end of either string is as good as stopping at it.
+            i = std::min({i, n, m - d});
+            current[d] = i < 0 ? none : slide(d, i);
+        }
+    }
+}
@@ -0,0 +1,226 @@
+/*
+    Optimal string alignment with per-character edit costs, for `DAMLEVW()`.
+
+    Every edit has its own cost: substituting one character for another has an entry
+    in a dense 256 x 256 table, and inserting, deleting and transposing a character
+    each have a vector of 256. Looking a cost up is then a single load, whatever the
+    cost specification looked like, so it is parsed once per statement.
+
+    A cost specification is a comma separated list of entries of the form KEY=WEIGHT,
+    applied from left to right on top of unit costs:
+
+        xy=w    Substituting x for y, or y for x, costs w.
+        *=w     Substituting any two different characters costs w.
+        +x=w    Inserting x costs w.        +=w     Inserting any character costs w.
+        -x=w    Deleting x costs w.         -=w     Deleting any character costs w.
+        ~x=w    Transposing x with its neighbour costs w, or the larger of the two
+                neighbours' costs.          ~=w     Any transposition costs w.
+
+    So "*=1,0O=0.2,1l=0.3" makes the usual OCR confusions cheap. Whitespace before a
+    key is skipped. Weights can not be negative, and insertions and deletions have to
+    cost something, or there would be no band to restrict the matrix to.
+
+    Released under the MIT license. See LICENSE.txt.
+*/
+
+#pragma once
+
+#include <algorithm>
+#include <cctype>
+#include <cstdlib>
+#include <limits>
+#include <string>
+#include <string_view>
+#include <vector>
+
+struct OsaCosts {
+    // substitute[x][y] is the cost of replacing x with y, and 0 when x == y.
+    double substitute[256][256];
+    double insert[256];
+    double erase[256];
+    double transpose[256];
+    // The cheapest insertion or deletion, which bounds how far from the diagonal an
+    // alignment can stray.
+    double min_indel;
+};
+
+// Sets every edit to cost 1.
+inline void osa_costs_default(OsaCosts &costs) {
+    for (int x = 0; x < 256; ++x) {
+        std::fill(costs.substitute[x], costs.substitute[x] + 256, 1.0);
+        costs.substitute[x][x] = 0.0;
+    }
+    std::fill(costs.insert, costs.insert + 256, 1.0);
+    std::fill(costs.erase, costs.erase + 256, 1.0);
+    std::fill(costs.transpose, costs.transpose + 256, 1.0);
+    costs.min_indel = 1.0;
+}
+
+// Parses `spec` on top of unit costs. Returns false if it is malformed or has a weight
+// that is not allowed, in which case `costs` is left half done.
+inline bool osa_costs_parse(std::string_view spec, OsaCosts &costs) {
+    osa_costs_default(costs);
+    // strtod needs a terminator.
+    const std::string text(spec);
+    const char *p = text.c_str();
+    const char *end = p + text.length();
+
+    while (p < end) {
+        while (p < end && std::isspace((unsigned char)*p)) {
+            ++p;
+        }
+        if (p == end) {
+            break;
+        }
+        // The key is one character for a default, otherwise an operator or first
+        // character followed by another character.
+        const unsigned char op = (unsigned char)*p++;
+        const bool is_default = p < end && '=' == *p;
+        unsigned char c = 0;
+        if (!is_default) {
+            if (p == end) {
+                return false;
+            }
+            c = (unsigned char)*p++;
+        }
+        if (p == end || '=' != *p++) {
+            return false;
+        }
+        char *number_end;
+        const double weight = std::strtod(p, &number_end);
+        if (number_end == p || !(weight >= 0.0) || weight == std::numeric_limits<double>::infinity()) {
+            return false;
+        }
+        p = number_end;
+        if (p < end && ',' != *p++) {
+            return false;
+        }
+
+        if (is_default) {
+            switch (op) {
+                case '*':
+                    for (int x = 0; x < 256; ++x) {
+                        std::fill(costs.substitute[x], costs.substitute[x] + 256, weight);
+                        costs.substitute[x][x] = 0.0;
+                    }
+                    break;
+                case '+':
+                    std::fill(costs.insert, costs.insert + 256, weight);
+                    break;
+                case '-':
+                    std::fill(costs.erase, costs.erase + 256, weight);
+                    break;
+                case '~':
+                    std::fill(costs.transpose, costs.transpose + 256, weight);
+                    break;
+                default:
+                    return false;
+            }
+            continue;
+        }
+        switch (op) {
+            case '+':
+                costs.insert[c] = weight;
+                break;
+            case '-':
+                costs.erase[c] = weight;
+                break;
+            case '~':
+                costs.transpose[c] = weight;
+                break;
+            default:
+                if (op != c) {
+                    costs.substitute[op][c] = weight;
+                    costs.substitute[c][op] = weight;
+                }
+        }
+    }
+
+    costs.min_indel = std::min(*std::min_element(costs.insert, costs.insert + 256),
+                               *std::min_element(costs.erase, costs.erase + 256));
+    return costs.min_indel > 0.0;
+}
+
+/*
+    Computes the cheapest way to edit `a` into `b` under `costs` if it costs at most
+    `max`, and returns some value greater than `max` otherwise.
+
+    Every insertion or deletion costs at least `min_indel`, so cells further than
+    max / min_indel from the diagonal are out of reach and only the band in between is
+    computed, a row at a time. Row minima never decrease, so the kernel gives up as
+    soon as two rows in a row are entirely above `max`.
+*/
+inline double osa_weighted(std::string_view a, std::string_view b, const OsaCosts &costs,
+                           double max, std::vector<double> &buffer) {
+    constexpr double inf = std::numeric_limits<double>::infinity();
+    const long long n = (long long)a.length();
+    const long long m = (long long)b.length();
+    const long long difference = n > m ? n - m : m - n;
+    const double reach = max / costs.min_indel;
+    if ((double)difference > reach) {
+        return inf;
+    }
+    const long long band = (long long)std::min(reach, (double)std::max(n, m));
+
+    const size_t stride = (size_t)m + 2;
+    if (buffer.size() < 3 * stride) {
+        buffer.resize(3 * stride);
+    }
+    double *before = buffer.data();
+    double *previous = before + stride;
+    double *current = previous + stride;
+
+    // Row 0: insert every character of b up to the band.
+    previous[0] = 0.0;
+    const long long first_end = std::min(m, band);
+    for (long long j = 1; j <= first_end; ++j) {
+        previous[j] = previous[j - 1] + costs.insert[(unsigned char)b[j - 1]];
+    }
+    previous[first_end + 1] = inf;
+    // Column 0, while it is in the band.
+    double column = 0.0;
+
+    bool hopeless = false;
+    for (long long i = 1; i <= n; ++i) {
+        const unsigned char x = (unsigned char)a[i - 1];
+        const double *substitute = costs.substitute[x];
+        const double erase = costs.erase[x];
+        const long long lo = std::max(1ll, i - band);
+        const long long hi = std::min(m, i + band);
+
+        column += erase;
+        current[lo - 1] = 1 == lo ? column : inf;
+        double row_min = current[lo - 1];
+        double left = current[lo - 1];
+        for (long long j = lo; j <= hi; ++j) {
+            const unsigned char y = (unsigned char)b[j - 1];
+            double value = std::min({previous[j] + erase,
+                                     left + costs.insert[y],
+                                     previous[j - 1] + substitute[y]});
+            if (i > 1 && j > 1 && x == (unsigned char)b[j - 2] &&
+                (unsigned char)a[i - 2] == y) {
+                value = std::min(value, before[j - 2] +
+                                        std::max(costs.transpose[x], costs.transpose[y]));
+            }
+            current[j] = value;
+            left = value;
+            row_min = std::min(row_min, value);
+        }
+        if (hi < m) {
+            current[hi + 1] = inf;
+        }
+
+        if (row_min > max) {
+            if (hopeless) {
+                return inf;
+            }
+            hopeless = true;
+        } else {
+            hopeless = false;
+        }
+        std::swap(before, previous);
+        std::swap(previous, current);
+    }
+
+    return previous[m] > max ? inf : previous[m];
+}
@@ -23,6 +23,18 @@
 #
 
 #include "benchtime.hpp"
+#include "../osa_filter.h"
+#include "../osa_simd.h"
+
+// The same harness again, for the functions with a limit.
+#undef LEV_FUNCTION
+#undef LEV_ARG_COUNT
+#define LEV_ARG_COUNT 3
+#define LEV_FUNCTION damlevconst
+#include "testharness.hpp"
+#undef LEV_FUNCTION
+#define LEV_FUNCTION damlevlim
+#include "testharness.hpp"
 
 
 extern "C" size_t lasm(const char *a, size_t alen, const char * b, size_t blen);
@@ -143,6 +155,62 @@ int main(int argc, char *argv[]) {
     double time_damlev = timer.elapsed();
     std::cout << "DAMLEV: Time elapsed: " << time_damlev << "s, Number of words: " << line_no << std::endl;
 
+    // Benchmark for medium-length pairs, cut back to back from the word list. These
+    // go through the vectorised kernel, so report DP cells per second, which can be
+    // compared across lengths.
+    const char *text = static_cast<const char *>(text_file_buffer.get_address());
+    const size_t text_size = text_file_buffer.get_size();
+    std::cout << "Vectorised kernel: " << osa_simd_name() << std::endl;
+    damlev_setup();
+    for (size_t length : {64ul, 256ul, 1000ul, 2000ul}) {
+        unsigned pairs = 0;
+        double cells = 0;
+        timer.reset();
+        for (size_t offset = 0; offset + 2 * length <= text_size && pairs < 2000;
+             offset += 2 * length) {
+            ++pairs;
+            damlev_call((char *)text + offset, length, (char *)text + offset + length, length, 1);
+            cells += (double)length * length;
+        }
+        std::cout << "DAMLEV, " << length << " characters: " << pairs << " pairs, "
+                  << cells / timer.elapsed() << " cells/s" << std::endl;
+    }
+    damlev_teardown();
+
+    // Benchmark for a scan against one word with a small limit, where almost every
+    // row is rejected by the lower bounds of osa_filter.h before any kernel runs.
+    // Built with OSA_FILTER_STATS, so it can say which bound rejected how many.
+    auto pattern = *std::next(crange(text_file_buffer).begin(), 1000);
+    const std::string constant(pattern.begin(), pattern.end() - (pattern.back() == '\n'));
+    for (const char *name : {"DAMLEVCONST", "DAMLEVLIM"}) {
+        const bool is_const = 'C' == name[6];
+        is_const ? damlevconst_setup() : damlevlim_setup();
+        osa_filter_stats = OsaFilterStats{};
+        line_no = 0;
+        long long matches = 0;
+        timer.reset();
+        for (auto a : crange(text_file_buffer)) {
+            const size_t length = a.size() - (a.back() == '\n');
+            // The harness call returns an int for damlevconst.
+            const long long distance =
+                    is_const ? (int)damlevconst_call((char *)a.begin(), length,
+                                                     (char *)constant.data(), constant.size(), 3)
+                             : damlevlim_call((char *)a.begin(), length,
+                                              (char *)constant.data(), constant.size(), 3);
+            matches += distance <= 3 ? 1 : 0;
+            if (++line_no > maximum_size) break;
+        }
+        double time_filter = timer.elapsed();
+        is_const ? damlevconst_teardown() : damlevlim_teardown();
+        const OsaFilterStats &stats = osa_filter_stats;
+        std::cout << name << "(word, \"" << constant << "\", 3): Time elapsed: " << time_filter
+                  << "s, Number of words: " << line_no << ", within 3: " << matches << std::endl;
+        std::cout << "    Filtered: " << stats.rows << ", rejected by length: " << stats.length
+                  << ", by bag distance: " << stats.bag << ", by q-grams: " << stats.qgram
+                  << ", passed to a kernel: "
+                  << stats.rows - stats.length - stats.bag - stats.qgram << std::endl;
+    }
+
     // Benchmark for calculateDamLevDistance
     line_no = 0;
     timer.reset();
@@ -0,0 +1,71 @@
+// Computes the optimal string alignment distance between the contents of two files,
+// spreading the work over a thread pool. For inputs far larger than a MySQL row,
+// such as configuration blobs pulled out of the database.
+//
+//     damlevfiles FILE1 FILE2 [THREADS [MAX]]
+//
+// THREADS defaults to one per hardware thread. Without MAX, the exact distance is
+// computed however large it is; with it, any distance above MAX is reported as
+// "> MAX", which is much faster for files that turn out to be very different.
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+
+#include "benchtime.hpp"
+#include "../osa_parallel.h"
+
+static bool read_file(const char *path, std::string &contents) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file) {
+        return false;
+    }
+    std::ostringstream buffer;
+    buffer << file.rdbuf();
+    contents = buffer.str();
+    return true;
+}
+
+int main(int argc, char *argv[]) {
+    if (argc < 3 || argc > 5) {
+        std::cerr << "Usage: " << argv[0] << " FILE1 FILE2 [THREADS [MAX]]" << std::endl;
+        return EXIT_FAILURE;
+    }
+    std::string a;
+    std::string b;
+    for (int i = 1; i <= 2; ++i) {
+        if (!read_file(argv[i], 1 == i ? a : b)) {
+            std::cerr << "Could not open file " << argv[i] << '.' << std::endl;
+            return EXIT_FAILURE;
+        }
+    }
+    const unsigned threads = argc > 3 ? (unsigned)std::strtoul(argv[3], nullptr, 10) : 0;
+    const long long ceiling = (long long)std::max(a.size(), b.size());
+    const long long max = argc > 4 ? std::strtoll(argv[4], nullptr, 10) : ceiling;
+
+    // Without a limit, double the band until it proves the distance, as osa_doubling
+    // does, so that similar files only cost a thin band around the diagonal.
+    Timer timer;
+    long long k = argc > 4 ? max
+                           : std::max(1024ll, ceiling - (long long)std::min(a.size(), b.size()));
+    long long distance;
+    while (true) {
+        k = std::min(k, max);
+        distance = osa_parallel(a, b, k, threads);
+        if (distance <= k || k == max) {
+            break;
+        }
+        k *= 2;
+    }
+    const double elapsed = timer.elapsed();
+
+    if (distance > max) {
+        std::cout << "> " << max << std::endl;
+    } else {
+        std::cout << distance << std::endl;
+    }
+    std::cerr << a.size() << " x " << b.size() << " characters in " << elapsed << "s" << std::endl;
+    return 0;
+}
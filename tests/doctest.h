@@ -5269,6 +5269,7 @@ int main(int argc, char **argv) {
     }
 
     printf("%s\n", "Hello, World!");
+    return res;
 }
 
 
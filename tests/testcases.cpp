@@ -51,7 +51,9 @@
 
 
 #define LEV_FUNCTION damlevconst
-
+#include "testharness.hpp"
+#undef LEV_FUNCTION
+#define LEV_FUNCTION damlevlim
 #include "testharness.hpp"
 
 
@@ -59,13 +61,900 @@
 #define DOCTEST_CONFIG_IMPLEMENT_WITH_MAIN
 #include "doctest.h"
 
+#include "../osa_filter.h"
+#include "../osa_parallel.h"
+#include "../osa_simd.h"
+#include "../osa_tiled.h"
+#include "../utf8.h"
+
+#include <cmath>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// damlevconst caches its constant on the first row, so every test case gets a fresh
+// statement.
+long long damlevconst_row(std::string subject, std::string constant, long long max) {
+    damlevconst_setup();
+    long long result = damlevconst_call(subject.data(), subject.size(), constant.data(), constant.size(), max);
+    damlevconst_teardown();
+    return result;
+}
+
+long long damlevlim_row(std::string subject, std::string query, long long max) {
+    damlevlim_setup();
+    long long result = damlevlim_call(subject.data(), subject.size(), query.data(), query.size(), max);
+    damlevlim_teardown();
+    return result;
+}
+
+// One argument of a UDF call, kept in whichever form its type asks for.
+struct Arg {
+    Item_result type;
+    std::string string;
+    long long integer;
+    double real;
+};
+
+Arg text(std::string value) {
+    return {STRING_RESULT, std::move(value), 0, 0.0};
+}
+
+Arg integer(long long value) {
+    return {INT_RESULT, "", value, (double)value};
+}
+
+Arg real(double value) {
+    return {REAL_RESULT, "", (long long)value, value};
+}
+
+/*
+    A statement, for the UDFs testharness.hpp does not fit: those that take other
+    numbers and types of arguments, that do not return an integer, or that have to
+    be called on several rows. Like MySQL, it hands every argument over in the type
+    the UDF's init asked for.
+*/
+class Statement {
+public:
+    Statement(bool (*init)(UDF_INIT *, UDF_ARGS *, char *), void (*deinit)(UDF_INIT *),
+              std::vector<Arg> row)
+            : deinit_(deinit), row_(std::move(row)), types_(row_.size()), args_(row_.size()),
+              lengths_(row_.size()), udf_args_(), initid_(), message_() {
+        for (size_t i = 0; i < row_.size(); ++i) {
+            types_[i] = row_[i].type;
+        }
+        udf_args_.arg_count = (unsigned int)row_.size();
+        udf_args_.arg_type = types_.data();
+        udf_args_.args = args_.data();
+        udf_args_.lengths = lengths_.data();
+        point();
+        failed_ = init(&initid_, &udf_args_, message_);
+    }
+
+    Statement(const Statement &) = delete;
+    Statement &operator=(const Statement &) = delete;
+
+    ~Statement() {
+        if (!failed_) {
+            deinit_(&initid_);
+        }
+    }
+
+    // The message init failed with, or "" if it did not.
+    std::string error() const {
+        return failed_ ? message_ : "";
+    }
+
+    // Replaces argument `i` for the rows after this.
+    void set(size_t i, Arg arg) {
+        row_[i] = std::move(arg);
+    }
+
+    template <typename Result>
+    Result call(Result (*udf)(UDF_INIT *, UDF_ARGS *, char *, char *)) {
+        point();
+        char is_null = 0;
+        char error = 0;
+        return udf(&initid_, &udf_args_, &is_null, &error);
+    }
+
+    // For string functions, which may return their result in a buffer of ours.
+    std::string call(char *(*udf)(UDF_INIT *, UDF_ARGS *, char *, unsigned long *, char *, char *)) {
+        point();
+        char result[255];
+        unsigned long length = 0;
+        char is_null = 0;
+        char error = 0;
+        const char *value = udf(&initid_, &udf_args_, result, &length, &is_null, &error);
+        return std::string(value, length);
+    }
+
+private:
+    void point() {
+        for (size_t i = 0; i < row_.size(); ++i) {
+            switch (types_[i]) {
+            case STRING_RESULT:
+                args_[i] = row_[i].string.data();
+                lengths_[i] = row_[i].string.size();
+                break;
+            case REAL_RESULT:
+                args_[i] = (char *)&row_[i].real;
+                lengths_[i] = sizeof(double);
+                break;
+            default:
+                args_[i] = (char *)&row_[i].integer;
+                lengths_[i] = sizeof(long long);
+                break;
+            }
+        }
+    }
+
+    void (*deinit_)(UDF_INIT *);
+    std::vector<Arg> row_;
+    std::vector<Item_result> types_;
+    std::vector<char *> args_;
+    std::vector<unsigned long> lengths_;
+    UDF_ARGS udf_args_;
+    UDF_INIT initid_;
+    char message_[512];
+    bool failed_;
+};
+
+extern "C" {
+bool damlevfull_init(UDF_INIT *initid, UDF_ARGS *args, char *message);
+long long damlevfull(UDF_INIT *initid, UDF_ARGS *args, char *is_null, char *error);
+void damlevfull_deinit(UDF_INIT *initid);
+}
+
+long long damlevfull_row(std::string a, std::string b) {
+    Statement statement(damlevfull_init, damlevfull_deinit, {text(a), text(b)});
+    return statement.call(damlevfull);
+}
+
+extern "C" {
+bool damlev_substr_init(UDF_INIT *initid, UDF_ARGS *args, char *message);
+long long damlev_substr(UDF_INIT *initid, UDF_ARGS *args, char *is_null, char *error);
+void damlev_substr_deinit(UDF_INIT *initid);
+}
+
+long long damlev_substr_row(std::string subject, std::string pattern, long long max) {
+    Statement statement(damlev_substr_init, damlev_substr_deinit,
+                        {text(subject), text(pattern), integer(max)});
+    return statement.call(damlev_substr);
+}
+
+extern "C" {
+bool damlev_prefix_init(UDF_INIT *initid, UDF_ARGS *args, char *message);
+long long damlev_prefix(UDF_INIT *initid, UDF_ARGS *args, char *is_null, char *error);
+void damlev_prefix_deinit(UDF_INIT *initid);
+}
+
+long long damlev_prefix_row(std::string candidate, std::string typed, long long max) {
+    Statement statement(damlev_prefix_init, damlev_prefix_deinit,
+                        {text(candidate), text(typed), integer(max)});
+    return statement.call(damlev_prefix);
+}
+
+extern "C" {
+bool damlev_indel_init(UDF_INIT *initid, UDF_ARGS *args, char *message);
+long long damlev_indel(UDF_INIT *initid, UDF_ARGS *args, char *is_null, char *error);
+void damlev_indel_deinit(UDF_INIT *initid);
+}
+
+long long damlev_indel_row(std::string a, std::string b) {
+    Statement statement(damlev_indel_init, damlev_indel_deinit, {text(a), text(b)});
+    return statement.call(damlev_indel);
+}
+
+long long damlev_indel_row(std::string a, std::string b, long long max) {
+    Statement statement(damlev_indel_init, damlev_indel_deinit,
+                        {text(a), text(b), integer(max)});
+    return statement.call(damlev_indel);
+}
+
+extern "C" {
+bool damlevw_init(UDF_INIT *initid, UDF_ARGS *args, char *message);
+double damlevw(UDF_INIT *initid, UDF_ARGS *args, char *is_null, char *error);
+void damlevw_deinit(UDF_INIT *initid);
+}
+
+double damlevw_row(std::string a, std::string b, std::string costs, double max) {
+    Statement statement(damlevw_init, damlevw_deinit,
+                        {text(a), text(b), text(costs), real(max)});
+    REQUIRE(statement.error() == "");
+    return statement.call(damlevw);
+}
+
+// Whether init turns `costs` down.
+bool damlevw_rejects(std::string costs) {
+    Statement statement(damlevw_init, damlevw_deinit,
+                        {text("a"), text("b"), text(costs), real(1.0)});
+    return statement.error().rfind("Invalid cost specification", 0) == 0;
+}
+
+extern "C" {
+bool damlev_ops_init(UDF_INIT *initid, UDF_ARGS *args, char *message);
+char *damlev_ops(UDF_INIT *initid, UDF_ARGS *args, char *result, unsigned long *length,
+                 char *is_null, char *error);
+void damlev_ops_deinit(UDF_INIT *initid);
+}
+
+std::string damlev_ops_row(std::string a, std::string b) {
+    Statement statement(damlev_ops_init, damlev_ops_deinit, {text(a), text(b)});
+    return statement.call(damlev_ops);
+}
+
+// Carries out `script` on `a`, taking inserted and substituted characters from `b`,
+// and counts the edits in it that are not `=`.
+std::string damlev_ops_apply(std::string a, std::string b, std::string script, long long &edits) {
+    std::istringstream runs(script);
+    std::string out;
+    size_t i = 0;
+    size_t j = 0;
+    edits = 0;
+    char op;
+    size_t count;
+    while (runs >> op >> count) {
+        for (size_t n = 0; n < count; ++n) {
+            switch (op) {
+            case '=':
+                out += a.at(i++);
+                ++j;
+                break;
+            case 'S':
+                out += b.at(j++);
+                ++i;
+                break;
+            case 'I':
+                out += b.at(j++);
+                break;
+            case 'D':
+                ++i;
+                break;
+            case 'T':
+                out += a.at(i + 1);
+                out += a.at(i);
+                i += 2;
+                j += 2;
+                break;
+            default:
+                FAIL("unknown edit " << op);
+            }
+            edits += '=' != op;
+        }
+    }
+    CHECK(i == a.size());
+    return out;
+}
+
+extern "C" {
+bool damlev_init(UDF_INIT *initid, UDF_ARGS *args, char *message);
+long long damlev(UDF_INIT *initid, UDF_ARGS *args, char *is_null, char *error);
+void damlev_deinit(UDF_INIT *initid);
+}
+
+long long damlev_row(std::string a, std::string b) {
+    Statement statement(damlev_init, damlev_deinit, {text(a), text(b)});
+    return statement.call(damlev);
+}
+
+long long damlev_row(std::string a, std::string b, long long flags) {
+    Statement statement(damlev_init, damlev_deinit, {text(a), text(b), integer(flags)});
+    return statement.call(damlev);
+}
+
+long long damlevlim_row(std::string a, std::string b, long long max, long long flags) {
+    Statement statement(damlevlim_init, damlevlim_deinit,
+                        {text(a), text(b), integer(max), integer(flags)});
+    return statement.call(damlevlim);
+}
+
+long long damlevconst_row(std::string subject, std::string constant, long long max,
+                          long long flags) {
+    Statement statement(damlevconst_init, damlevconst_deinit,
+                        {text(subject), text(constant), integer(max), integer(flags)});
+    return statement.call(damlevconst);
+}
+
+extern "C" {
+bool damlev_dna_init(UDF_INIT *initid, UDF_ARGS *args, char *message);
+long long damlev_dna(UDF_INIT *initid, UDF_ARGS *args, char *is_null, char *error);
+void damlev_dna_deinit(UDF_INIT *initid);
+}
+
+long long damlev_dna_row(std::string a, std::string b, long long max) {
+    Statement statement(damlev_dna_init, damlev_dna_deinit, {text(a), text(b), integer(max)});
+    return statement.call(damlev_dna);
+}
+
+extern "C" {
+bool damlevp_init(UDF_INIT *initid, UDF_ARGS *args, char *message);
+double damlevp(UDF_INIT *initid, UDF_ARGS *args, char *is_null, char *error);
+void damlevp_deinit(UDF_INIT *initid);
+bool damlevplim_init(UDF_INIT *initid, UDF_ARGS *args, char *message);
+double damlevplim(UDF_INIT *initid, UDF_ARGS *args, char *is_null, char *error);
+void damlevplim_deinit(UDF_INIT *initid);
+}
+
+double damlevp_row(std::string a, std::string b, long long flags = 0) {
+    Statement statement(damlevp_init, damlevp_deinit, {text(a), text(b), integer(flags)});
+    return statement.call(damlevp);
+}
+
+double damlevplim_row(std::string a, std::string b, Arg ratio, long long flags = 0) {
+    Statement statement(damlevplim_init, damlevplim_deinit,
+                        {text(a), text(b), ratio, integer(flags)});
+    return statement.call(damlevplim);
+}
+
+// DAMLEVPLIM has to give DAMLEVP's result exactly when it is at most the ratio, and
+// 1.0 when it is not, right up to the boundary.
+void check_damlevplim_boundary(std::string a, std::string b, long long flags = 0) {
+    const double p = damlevp_row(a, b, flags);
+    CAPTURE(a);
+    CAPTURE(b);
+    CHECK(damlevplim_row(a, b, real(p), flags) == p);
+    CHECK(damlevplim_row(a, b, real(std::nextafter(p, 2.0)), flags) == p);
+    if (p > 0.0 && p < 1.0) {
+        CHECK(damlevplim_row(a, b, real(std::nextafter(p, 0.0)), flags) == 1.0);
+    }
+}
+
+// `length` different Cyrillic letters, more than the one-byte rewrite has room for.
+std::string utf8_alphabet_string(size_t length) {
+    std::string out;
+    for (size_t i = 0; i < length; ++i) {
+        utf8_append((char32_t)(0x400 + i), out);
+    }
+    return out;
+}
+
 TEST_CASE("empty strings are distance 0")
 {
-    REQUIRE(LEV_CALL("",2,"",2,2));
+    REQUIRE(damlevconst_row("", "", 2) == 0);
+}
+
+TEST_CASE("adjacent transpositions cost one edit")
+{
+    CHECK(damlevconst_row("ab", "ba", 5) == 1);
+    CHECK(damlevconst_row("Levenshtien", "Levenshtein", 5) == 1);
+    CHECK(damlevconst_row("ca", "abc", 5) == 3);
+}
+
+TEST_CASE("a trimmed constant gives the same distance as the whole one")
+{
+    CHECK(damlevconst_row("Vladimir Iosifovich Levenshtein", "Vladimir Iosifovich Levenshtein", 6) == 0);
+    CHECK(damlevconst_row("Vladimir Josifovitch Levenshtein", "Vladimir Iosifovich Levenshtein", 6) == 2);
+    CHECK(damlevconst_row("Vladimir Iosifovich Levensthein", "Vladimir Iosifovich Levenshtein", 6) == 1);
+}
+
+TEST_CASE("distances over the limit are reported as the longer string's length")
+{
+    CHECK(damlevconst_row("kitten", "sitting", 2) == 7);
+    CHECK(damlevconst_row("kitten", "sitting", 3) == 3);
+}
+
+TEST_CASE("constants longer than one word")
+{
+    std::string address = "1600 Pennsylvania Avenue NW, Washington, DC 20500, United States of America";
+    CHECK(damlevconst_row(address, address, 3) == 0);
+    CHECK(damlevconst_row("1600 Pensylvania Avenue NW, Washington, DC 20500, United States of Amercia", address, 3) == 2);
+    CHECK(damlevconst_row("1600 Pensylvania Avenue NW, Washington, DC 20500, United States of Amercia", address, 1)
+          == (long long)address.size());
+}
+
+TEST_CASE("long strings a few edits apart")
+{
+    std::string document;
+    for (int i = 0; document.size() < 20000; ++i) {
+        document += "Paragraph " + std::to_string(i) + " of a scanned document. ";
+    }
+    std::string scanned = document;
+    scanned[100] = 'X';                            // substitution
+    std::swap(scanned[5000], scanned[5001]);       // transposition
+    scanned.erase(12000, 1);                       // deletion
+    scanned.insert(18000, "Z");                    // insertion
+    CHECK(damlevconst_row(scanned, document, 5) == 4);
+    CHECK(damlevconst_row(scanned, document, 3) == (long long)document.size());
+}
+
+TEST_CASE("strings on either side of the register kernel's length")
+{
+    // One character can only be substituted, so it is never over a limit of 1.
+    CHECK(damlevlim_row("a", "b", 1) == 1);
+    CHECK(damlevconst_row("a", "b", 1) == 1);
+    CHECK(damlevconst_row("a", "a", 1) == 0);
+    CHECK(damlevlim_row("ab", "ba", 1) == 1);
 
+    // OSA_SHORT_MAX_LENGTH characters, the longest the register kernel takes.
+    const std::string sixteen = "abcdefghijklmnop";
+    CHECK(damlevlim_row("abcdefghijklmnpo", sixteen, 1) == 1);
+    CHECK(damlevconst_row("bacdefghijklmnop", sixteen, 1) == 1);
+    CHECK(damlevlim_row("abcdefgh1234mnop", sixteen, 3) == 16);
+    CHECK(damlevconst_row("abcdefgh1234mnop", sixteen, 3) == 16);
+    CHECK(damlevlim_row("abcdefgh1234mnop", sixteen, 4) == 4);
+    CHECK(damlev_row("abcdefgh1234mnpo", sixteen) == 5);
 
+    // One more, which goes to the bit-parallel and banded kernels instead.
+    const std::string seventeen = "abcdefghijklmnopq";
+    CHECK(damlevlim_row("abcdefghijklmnoqp", seventeen, 1) == 1);
+    CHECK(damlevconst_row("bacdefghijklmnopq", seventeen, 1) == 1);
+    CHECK(damlevlim_row("abcdefgh1234mnopq", seventeen, 3) == 17);
+    CHECK(damlevconst_row("abcdefgh1234mnopq", seventeen, 3) == 17);
+    CHECK(damlevlim_row("abcdefgh1234mnopq", seventeen, 4) == 4);
+    CHECK(damlev_row("abcdefgh1234mnoqp", seventeen) == 5);
 }
 
+TEST_CASE("limits wide enough for the tiled kernel")
+{
+    // None of the digits are in the text, so each one costs an edit and the bag
+    // distance shows no alignment does better. A limit of 2000 is a band of 3001.
+    std::string text;
+    for (unsigned i = 0; text.size() < 3000; ++i) {
+        text += (char)('a' + (i * 7919u) % 26);
+    }
+    std::string garbled = text;
+    for (size_t i = 0; i < 1500; ++i) {
+        garbled[i] = (char)('0' + i % 10);
+    }
+    CHECK(damlevlim_row(garbled, text, 2000) == 1500);
+    CHECK(damlevlim_row(garbled, text, 1499) == (long long)text.size());
+    CHECK(damlevlim_row(garbled, text + "xyz", 5000) == 1503);
+}
+
+TEST_CASE("the wavefront on two threads agrees with the tiled kernel")
+{
+    // Long enough for a couple of dozen strips of tiles, which the two threads take
+    // turns at and hand borders between.
+    std::string a;
+    for (unsigned i = 0; a.size() < 5000; ++i) {
+        a += (char)('a' + (i * 7919u) % 26);
+    }
+    std::string b = a;
+    for (size_t i = 0; i < b.size(); i += 37) {
+        b[i] = '#';
+    }
+    b.erase(1000, 20);
+    b.insert(3000, "inserted");
+
+    OsaBuffer buffer;
+    for (const long long max : {5000ll, 200ll, 50ll}) {
+        CAPTURE(max);
+        const long long tiled = osa_tiled(a, b, max, buffer);
+        const long long parallel = osa_parallel(a, b, max, 2);
+        // Over the limit, each only promises something greater than it.
+        if (tiled <= max) {
+            CHECK(parallel == tiled);
+        } else {
+            CHECK(parallel > max);
+        }
+    }
+    CHECK(osa_parallel(a, a, 10, 2) == 0);
+}
+
+TEST_CASE("DAMLEVFULL edits a substring more than once")
+{
+    CHECK(damlevfull_row("ca", "abc") == 2);
+    CHECK(damlevfull_row("ab", "ba") == 1);
+    CHECK(damlevfull_row("kitten", "sitting") == 3);
+    CHECK(damlevfull_row("Vladimir Josifovitch Levenshtein", "Vladimir Iosifovich Levenshtein") == 2);
+    CHECK(damlevfull_row("abcdef", "badcfe") == 3);
+}
+
+TEST_CASE("DAMLEVFULL of an empty string is the other one's length")
+{
+    CHECK(damlevfull_row("", "") == 0);
+    CHECK(damlevfull_row("", "abc") == 3);
+    CHECK(damlevfull_row("abcd", "") == 4);
+}
+
+TEST_CASE("DAMLEV_SUBSTR finds the pattern anywhere in the text")
+{
+    const std::string fox = "The quick brown fox jumps over the lazy dog";
+    CHECK(damlev_substr_row(fox, "brown", 0) == 0);
+    CHECK(damlev_substr_row(fox, "bruwn", 1) == 1);
+    CHECK(damlev_substr_row(fox, "quikc", 2) == 1);
+    CHECK(damlev_substr_row(fox, "jmups ovr", 2) == 2);
+    CHECK(damlev_substr_row("Levenshtein", "Levenshtein distance", 9) == 9);
+}
+
+TEST_CASE("DAMLEV_SUBSTR patterns longer than one word")
+{
+    std::string pattern;
+    for (int i = 0; pattern.size() < 100; ++i) {
+        pattern += "pattern " + std::to_string(i) + " ";
+    }
+    std::string typo = pattern;
+    typo[10] = '#';
+    std::swap(typo[50], typo[51]);
+    const std::string text = std::string(500, '.') + typo + std::string(500, '.');
+    CHECK(damlev_substr_row(text, pattern, 3) == 2);
+    CHECK(damlev_substr_row(text, pattern, 1) == (long long)pattern.size());
+}
+
+TEST_CASE("DAMLEV_SUBSTR compiles a pattern once for many texts")
+{
+    Statement statement(damlev_substr_init, damlev_substr_deinit,
+                        {text("a Levenstein here"), text("Levenshtein"), integer(2)});
+    CHECK(statement.call(damlev_substr) == 1);
+    statement.set(0, text("no match at all"));
+    CHECK(statement.call(damlev_substr) == 11);
+    statement.set(0, text("Levenshtein"));
+    CHECK(statement.call(damlev_substr) == 0);
+    statement.set(1, text("Hamming"));
+    CHECK(statement.call(damlev_substr) == 7);
+}
+
+TEST_CASE("DAMLEV_PREFIX matches what has been typed against any prefix")
+{
+    CHECK(damlev_prefix_row("Levenshtein", "Levensh", 0) == 0);
+    CHECK(damlev_prefix_row("Levenshtein", "levensh", 2) == 1);
+    CHECK(damlev_prefix_row("Levenshtein", "Lveensh", 2) == 1);
+    CHECK(damlev_prefix_row("Vladimir Iosifovich Levenshtein", "Vladmir Io", 2) == 1);
+    CHECK(damlev_prefix_row("Lev", "Levenshtein", 10) == 8);
+}
+
+TEST_CASE("DAMLEV_PREFIX reads no more of a long candidate than it needs")
+{
+    const std::string candidate = "Levenshtein" + std::string(100000, 'x');
+    CHECK(damlev_prefix_row(candidate, "Levenstein", 1) == 1);
+    CHECK(damlev_prefix_row(candidate, "Lewenstein", 1) == 10);
+}
+
+TEST_CASE("DAMLEV_INDEL counts a substitution as two edits")
+{
+    CHECK(damlev_indel_row("abc", "abc") == 0);
+    CHECK(damlev_indel_row("cat", "cut") == 2);
+    CHECK(damlev_indel_row("ab", "ba") == 2);
+    CHECK(damlev_indel_row("kitten", "sitting") == 5);
+    CHECK(damlev_indel_row("kitten", "sitting", 5) == 5);
+}
+
+TEST_CASE("DAMLEV_INDEL strings longer than one word")
+{
+    std::string document;
+    for (int i = 0; document.size() < 300; ++i) {
+        document += "line " + std::to_string(i) + "; ";
+    }
+    std::string edited = document;
+    edited[20] = '#';
+    edited.erase(200, 1);
+    CHECK(damlev_indel_row(edited, document) == 3);
+    CHECK(damlev_indel_row(edited, document, 3) == 3);
+    CHECK(damlev_indel_row(edited, document, 2) == (long long)(edited.size() + document.size()));
+}
+
+TEST_CASE("DAMLEVW makes the edits it is given cheaper")
+{
+    CHECK(damlevw_row("kitten", "sitting", "", 5) == doctest::Approx(3.0));
+    CHECK(damlevw_row("B0L7-118", "BOL7-118", "0O=0.25", 1) == doctest::Approx(0.25));
+    CHECK(damlevw_row("B0L7-1l8", "BOL7-118", "*=1, 0O=0.25, 1l=0.5", 2) == doctest::Approx(0.75));
+    CHECK(damlevw_row("cat", "cut", "*=2", 5) == doctest::Approx(2.0));
+    CHECK(damlevw_row("ab", "a b", "+ =0.5", 1) == doctest::Approx(0.5));
+    CHECK(damlevw_row("abxc", "abc", "-x=0.25", 1) == doctest::Approx(0.25));
+    CHECK(damlevw_row("ab", "ba", "~=0.5", 1) == doctest::Approx(0.5));
+}
+
+TEST_CASE("DAMLEVW rejects a malformed cost specification")
+{
+    CHECK_FALSE(damlevw_rejects(""));
+    CHECK_FALSE(damlevw_rejects("*=1,0O=0.2,+ =0.5"));
+    CHECK(damlevw_rejects("0O"));
+    CHECK(damlevw_rejects("0O=abc"));
+    CHECK(damlevw_rejects("0O=0.2;1l=0.3"));
+    CHECK(damlevw_rejects("?=1"));
+    CHECK(damlevw_rejects("0O=-1"));
+    CHECK(damlevw_rejects("+=0"));
+    CHECK(damlevw_rejects("-=0"));
+
+    Statement statement(damlevw_init, damlevw_deinit, {text("a"), text("b"), text("")});
+    CHECK(statement.error() != "");
+}
+
+TEST_CASE("DAMLEV_OPS spells out the edits")
+{
+    CHECK(damlev_ops_row("abc", "abc") == "=3");
+    CHECK(damlev_ops_row("ab", "ba") == "T1");
+    CHECK(damlev_ops_row("abc", "abxc") == "=2 I1 =1");
+    CHECK(damlev_ops_row("abxc", "abc") == "=2 D1 =1");
+    CHECK(damlev_ops_row("abc", "axc") == "=1 S1 =1");
+    CHECK(damlev_ops_row("Levenshtein", "Levnehstien") == "=3 T2 =1 T1 =1");
+}
+
+TEST_CASE("DAMLEV_OPS of an empty string")
+{
+    CHECK(damlev_ops_row("", "") == "");
+    CHECK(damlev_ops_row("", "ab") == "I2");
+    CHECK(damlev_ops_row("abc", "") == "D3");
+}
+
+TEST_CASE("DAMLEV_OPS scripts are as long as the distance")
+{
+    std::string document;
+    for (int i = 0; document.size() < 3000; ++i) {
+        document += "Paragraph " + std::to_string(i) + " of a scanned document. ";
+    }
+    std::string scanned = document;
+    scanned[100] = 'X';
+    std::swap(scanned[1000], scanned[1001]);
+    scanned.erase(1500, 3);
+    scanned.insert(2500, "ZZ");
+    const std::string script = damlev_ops_row(scanned, document);
+    long long edits;
+    CHECK(damlev_ops_apply(scanned, document, script, edits) == document);
+    CHECK(edits == damlevlim_row(scanned, document, 100));
+    CHECK(edits == 7);
+
+    CHECK(damlev_ops_apply("kitten", "sitting", damlev_ops_row("kitten", "sitting"), edits) == "sitting");
+    CHECK(edits == 3);
+    CHECK(damlev_ops_apply("ca", "abc", damlev_ops_row("ca", "abc"), edits) == "abc");
+    CHECK(edits == 3);
+}
+
+TEST_CASE("the UTF-8 flag counts code points instead of bytes")
+{
+    CHECK(damlev_row("é", "e", 1) == 1);
+    CHECK(damlev_row("é", "e", 0) == 2);
+    CHECK(damlev_row("é", "e") == 2);
+    CHECK(damlevlim_row("é", "e", 5, 1) == 1);
+    CHECK(damlevlim_row("é", "e", 5, 0) == 2);
+    CHECK(damlevconst_row("é", "e", 5, 1) == 1);
+    CHECK(damlevconst_row("é", "e", 5, 0) == 2);
 
+    CHECK(damlev_row("naïve café", "naive cafe", 1) == 2);
+    CHECK(damlev_row("naïve café", "naive cafe", 0) == 4);
+    CHECK(damlev_row("日本語", "日本人", 1) == 1);
+    CHECK(damlev_row("日本語", "本日語", 1) == 1);
+    CHECK(damlevlim_row("naïve café", "naive cafe", 1, 1) == 10);
+    CHECK(damlevconst_row("naïve café", "naive cafe", 1, 1) == 10);
+}
 
+TEST_CASE("the UTF-8 flag with more code points than fit in a byte")
+{
+    const std::string many = utf8_alphabet_string(200);
+    std::u32string wide;
+    utf8_decode(many, wide);
+    wide[10] = 0x500;
+    wide[50] = 0x501;
+    wide[90] = 0x502;
+    std::swap(wide[150], wide[151]);
+    std::string edited;
+    for (const char32_t code_point : wide) {
+        utf8_append(code_point, edited);
+    }
+
+    CHECK(damlev_row(many, edited, 1) == 4);
+    CHECK(damlev_row(edited, many, 1) == 4);
+    CHECK(damlev_row(many, many, 1) == 0);
+    CHECK(damlevlim_row(many, edited, 10, 1) == 4);
+    CHECK(damlevlim_row(edited, many, 3, 1) == 200);
+    CHECK(damlevconst_row(edited, many, 10, 1) == 4);
+    CHECK(damlevconst_row(edited, many, 3, 1) == 200);
+    CHECK(damlevconst_row("abc", many, 300, 1) == 200);
+}
 
+TEST_CASE("the UTF-8 flag keeps invalid bytes as characters of their own")
+{
+    // A truncated sequence, a stray continuation byte, an overlong encoding of '/'
+    // and a byte that never starts a sequence.
+    CHECK(damlev_row("caf\xc3", "café", 1) == 1);
+    CHECK(damlev_row("caf\xc3", "caf", 1) == 1);
+    CHECK(damlev_row("\xa9", "é", 1) == 1);
+    CHECK(damlev_row("\xc0\xaf", "/", 1) == 2);
+    CHECK(damlev_row("a\xff" "b", "a\xff" "b", 1) == 0);
+    CHECK(damlev_row("a\xff" "b", "ab", 1) == 1);
+    CHECK(damlevlim_row("caf\xc3", "café", 2, 1) == 1);
+    CHECK(damlevlim_row("\xc0\xaf", "/", 2, 1) == 2);
+    CHECK(damlevconst_row("caf\xc3", "café", 2, 1) == 1);
+    CHECK(damlevconst_row("café", "caf\xc3", 2, 1) == 1);
+}
+
+TEST_CASE("DAMLEVCONST reuses a UTF-8 constant on every row")
+{
+    Statement statement(damlevconst_init, damlevconst_deinit,
+                        {text("Dvořák"), text("Dvořák"), integer(2), integer(1)});
+    CHECK(statement.call(damlevconst) == 0);
+    statement.set(0, text("Dvorak"));
+    CHECK(statement.call(damlevconst) == 2);
+    statement.set(0, text("Dvořak"));
+    CHECK(statement.call(damlevconst) == 1);
+    statement.set(0, text("Ðvořák"));
+    CHECK(statement.call(damlevconst) == 1);
+    statement.set(0, text("Dvoářk"));
+    CHECK(statement.call(damlevconst) == 1);
+    statement.set(0, text("Smetana"));
+    CHECK(statement.call(damlevconst) == 7);
+    statement.set(0, text("Dvořákův"));
+    CHECK(statement.call(damlevconst) == 2);
+
+    const std::string many = utf8_alphabet_string(200);
+    std::string edited = many;
+    edited.replace(20, 2, "é");
+    Statement wide(damlevconst_init, damlevconst_deinit,
+                   {text(many), text(many), integer(2), integer(1)});
+    CHECK(wide.call(damlevconst) == 0);
+    wide.set(0, text(edited));
+    CHECK(wide.call(damlevconst) == 1);
+    wide.set(0, text("abc"));
+    CHECK(wide.call(damlevconst) == 200);
+    wide.set(0, text(many));
+    CHECK(wide.call(damlevconst) == 0);
+}
+
+TEST_CASE("folding case and accents together")
+{
+    CHECK(damlev_row("Dvořák", "dvorak", 1 | 2 | 4) == 0);
+    CHECK(damlev_row("Dvořák", "DVORAK", 2 | 4) == 0);
+    CHECK(damlevlim_row("Dvořák", "dvorak", 2, 1 | 2 | 4) == 0);
+    CHECK(damlevconst_row("Dvořák", "dvorak", 2, 1 | 2 | 4) == 0);
+    CHECK(damlevconst_row("dvorak", "Dvořák", 2, 1 | 2 | 4) == 0);
+    CHECK(damlev_row("Dvořák", "dvorak", 1) == 3);
+    CHECK(damlev_row("Dvořák", "dvorak", 0) == 5);
+}
+
+TEST_CASE("each folding flag folds only what it names")
+{
+    // Case alone keeps the accents.
+    CHECK(damlev_row("DVOŘÁK", "dvořák", 2) == 0);
+    CHECK(damlev_row("Dvořák", "dvorak", 1 | 2) == 2);
+    CHECK(damlev_row("É", "é", 2) == 0);
+    CHECK(damlev_row("É", "e", 1 | 2) == 1);
+    CHECK(damlev_row("ΣΟΦΙΑ", "σοφια", 2) == 0);
+    CHECK(damlev_row("МОСКВА", "москва", 2) == 0);
+
+    // Accents alone keep the case.
+    CHECK(damlev_row("Dvořák", "Dvorak", 4) == 0);
+    CHECK(damlev_row("Dvořák", "dvorak", 4) == 1);
+    CHECK(damlev_row("É", "e", 4) == 1);
+    CHECK(damlev_row("É", "E", 4) == 0);
+    CHECK(damlev_row("cafe\xcc\x81", "cafe", 4) == 0);
+    CHECK(damlev_row("cafe\xcc\x81", "cafe", 2) == 2);
+
+    // Letters that are not an accent away from ASCII stay as they are.
+    CHECK(damlev_row("straße", "strasse", 1 | 2 | 4) == 2);
+    CHECK(damlevlim_row("Straße", "strasse", 5, 1 | 2 | 4) == 2);
+}
+
+TEST_CASE("DAMLEVCONST folds its constant once and reuses it")
+{
+    Statement statement(damlevconst_init, damlevconst_deinit,
+                        {text("dvorak"), text("DVOŘÁK"), integer(2), integer(1 | 2 | 4)});
+    CHECK(statement.call(damlevconst) == 0);
+    statement.set(0, text("Dvořák"));
+    CHECK(statement.call(damlevconst) == 0);
+    statement.set(0, text("dvořak!"));
+    CHECK(statement.call(damlevconst) == 1);
+    statement.set(0, text("DVROAK"));
+    CHECK(statement.call(damlevconst) == 1);
+    statement.set(0, text("Smetana"));
+    CHECK(statement.call(damlevconst) == 7);
+    statement.set(0, text("dvorak"));
+    CHECK(statement.call(damlevconst) == 0);
+
+    // Case alone, with bytes instead of code points.
+    Statement cased(damlevconst_init, damlevconst_deinit,
+                    {text("dvořák"), text("DVOŘÁK"), integer(2), integer(2)});
+    CHECK(cased.call(damlevconst) == 0);
+    cased.set(0, text("Dvořak"));
+    CHECK(cased.call(damlevconst) == 2);
+    cased.set(0, text("DVOŘÁK"));
+    CHECK(cased.call(damlevconst) == 0);
+}
+
+TEST_CASE("DAMLEV_DNA compares bases")
+{
+    CHECK(damlev_dna_row("ACGTACGTTGCA", "ACGTACGTTGCA", 1) == 0);
+    CHECK(damlev_dna_row("acgtacgttgca", "ACGTACGTTGCA", 0) == 0);
+    CHECK(damlev_dna_row("ACGU", "ACGT", 0) == 0);
+    CHECK(damlev_dna_row("ACGT", "AGCT", 2) == 1);
+    CHECK(damlev_dna_row("ACGTACGT", "ACGACGT", 2) == 1);
+    CHECK(damlev_dna_row("ACGTACGT", "ACTTACGA", 2) == 2);
+    // An unknown base matches nothing, not even another one.
+    CHECK(damlev_dna_row("ACNT", "ACNT", 2) == 1);
+    CHECK(damlev_dna_row("NN", "NN", 5) == 2);
+    CHECK(damlev_dna_row("ACGT", "AXGT", 2) == 1);
+}
+
+TEST_CASE("DAMLEV_DNA reads longer than one word")
+{
+    std::string read;
+    for (unsigned i = 0; read.size() < 200; ++i) {
+        read += "ACGT"[(i * 2654435761u) >> 30];
+    }
+    std::string mutated = read;
+    mutated[60] = 'A' == mutated[60] ? 'C' : 'A';
+    mutated.insert(150, "G");
+    CHECK(damlev_dna_row(mutated, read, 3) == 2);
+    CHECK(damlev_dna_row(read, mutated, 2) == 2);
+    CHECK(damlev_dna_row(mutated, read, 1) == (long long)mutated.size());
+}
+
+TEST_CASE("an upper bound equal to the length difference is the distance")
+{
+    // Lined up with the end of the longer string, the shorter one matches exactly, so
+    // the two inserted characters are all there is and no kernel has to run.
+    const std::string query = "Levenshtein distance";
+    const std::string subject = "XY" + query;
+    CHECK(osa_upper_bound(subject, query) == 2);
+    CHECK(damlevlim_row(subject, query, 5) == 2);
+    CHECK(damlevlim_row(subject, query, 2) == 2);
+    CHECK(damlevlim_row(subject, query, 1) == 22);
+    CHECK(damlevconst_row(subject, query, 5) == 2);
+
+    // One substitution more and the bound is only a bound.
+    const std::string edited = "XY" + query.substr(0, 10) + "_" + query.substr(11);
+    CHECK(osa_upper_bound(edited, query) == 3);
+    CHECK(damlevlim_row(edited, query, 5) == 3);
+    CHECK(damlevconst_row(edited, query, 5) == 3);
+}
+
+TEST_CASE("rows a lower bound rejects are reported as the longer string's length")
+{
+    const std::string name = "Vladimir Iosifovich Levenshtein";
+
+    // The length difference, here of a prefix of the constant, which used to come back
+    // as its exact distance.
+    CHECK(damlevconst_row("Vladimir", name, 3) == 31);
+    CHECK(damlevlim_row("Vladimir", name, 3) == 31);
+    CHECK(damlevconst_row("Vladimir Iosifovich", name, 12) == 12);
+
+    // The bag distance: four letters of one are not in the other.
+    OsaFilter filter;
+    osa_filter_compile(filter, "abcdefgh");
+    CHECK(osa_bag_bound(filter, "abcdwxyz") == 4);
+    CHECK(damlevconst_row("abcdwxyz", "abcdefgh", 3) == 8);
+    // A bag distance of exactly the limit is not enough to reject the row.
+    CHECK(damlevconst_row("abcdwxyz", "abcdefgh", 4) == 4);
+
+    // The bigram count: the same letters, but swapped in pairs so that no bigram is left.
+    OsaFilter letters;
+    osa_filter_compile(letters, "abcdefghij");
+    CHECK(osa_bag_bound(letters, "badcfehgji") == 0);
+    CHECK(osa_qgram_bound(letters, "badcfehgji") == 3);
+    CHECK(damlevconst_row("badcfehgji", "abcdefghij", 2) == 10);
+    CHECK(damlevconst_row("badcfehgji", "abcdefghij", 5) == 5);
+    // DAMLEVLIM only filters strings too long for the register kernel.
+    CHECK(damlevlim_row("badcfehgjilknmporqts", "abcdefghijklmnopqrst", 3) == 20);
+    CHECK(damlevlim_row("badcfehgjilknmporqts", "abcdefghijklmnopqrst", 10) == 10);
+}
+
+TEST_CASE("DAMLEVPLIM is DAMLEVP within the ratio")
+{
+    CHECK(damlevplim_row("kitten", "sitting", real(0.5)) == doctest::Approx(3.0 / 7.0));
+    CHECK(damlevplim_row("Vladimir Josifovitch Levenshtein", "Vladimir Iosifovich Levenshtein",
+                         real(0.2)) == doctest::Approx(2.0 / 32.0));
+    CHECK(damlevplim_row("abc", "abc", real(0.0)) == 0.0);
+    // An integer ratio is handed over as a real.
+    CHECK(damlevplim_row("kitten", "sitting", integer(1)) == damlevp_row("kitten", "sitting"));
+    CHECK(damlevplim_row("Dvořák", "dvorak", real(0.1), 1 | 2 | 4) == 0.0);
+    CHECK(damlevplim_row("é", "e", real(0.5), 1) == 1.0);
+    CHECK(damlevplim_row("éa", "ea", real(0.5), 1) == 0.5);
+}
+
+TEST_CASE("DAMLEVPLIM agrees with DAMLEVP at the ratio boundary")
+{
+    CHECK(damlevplim_row("abcdefghij", "abcdefgxyz", real(0.3)) == damlevp_row("abcdefghij", "abcdefgxyz"));
+    check_damlevplim_boundary("kitten", "sitting");
+    check_damlevplim_boundary("ab", "ba");
+    check_damlevplim_boundary("abcdefghij", "abcdefgxyz");
+    check_damlevplim_boundary("Vladimir Josifovitch Levenshtein", "Vladimir Iosifovich Levenshtein");
+    check_damlevplim_boundary("naïve café", "naive cafe", 1);
+
+    std::string document;
+    for (int i = 0; document.size() < 5000; ++i) {
+        document += "Paragraph " + std::to_string(i) + " of a scanned document. ";
+    }
+    std::string scanned = document;
+    scanned[100] = 'X';
+    std::swap(scanned[2000], scanned[2001]);
+    scanned.erase(3000, 1);
+    check_damlevplim_boundary(scanned, document);
+
+    // A third of the characters replaced makes for a band too wide to be cheap.
+    std::string garbled = document.substr(0, 1500);
+    for (size_t i = 0; i < garbled.size(); i += 3) {
+        garbled[i] = '#';
+    }
+    check_damlevplim_boundary(garbled, document.substr(0, 1500));
+    check_damlevplim_boundary(garbled, document.substr(0, 1600));
+}
@@ -43,6 +43,12 @@
 #define LEV_FUNCTION damlev
 #endif
 
+// The number of arguments LEV_FUNCTION takes: 2 for damlev, 3 for damlevlim and
+// damlevconst.
+#ifndef LEV_ARG_COUNT
+#define LEV_ARG_COUNT 2
+#endif
+
 /*
  * Concatenate preprocessor tokens A and B without expanding macro definitions
  * (however, if invoked from a macro, macro arguments are expanded).
@@ -94,8 +100,7 @@ void LEV_SETUP(){
     LEV_ARGS->arg_type = new Item_result[3];
     LEV_ARGS->args = new char*[3];
     LEV_ARGS->lengths = new unsigned long[3];
-    //TODO: need to put a try for 3 or 2 here.
-    LEV_ARGS->arg_count = 2;
+    LEV_ARGS->arg_count = LEV_ARG_COUNT;
     LEV_ARGS->arg_type[0] = STRING_RESULT;
     LEV_ARGS->arg_type[1] = STRING_RESULT;
     LEV_ARGS->arg_type[2] = INT_RESULT;
@@ -0,0 +1,265 @@
+/*
+    UTF-8 mode for the edit distance UDFs.
+
+    Every kernel in this library compares bytes, so a two-byte "é" counts as two
+    characters and replacing it with "e" costs two edits. In UTF-8 mode the strings
+    are compared a code point at a time instead, without a second set of kernels:
+    the code points of one string are numbered, and both strings are rewritten as one
+    byte per code point before they reach the usual byte kernels.
+
+    * ASCII code points keep their own byte, so pure ASCII never has to be rewritten,
+      which osa_is_ascii checks a vector at a time.
+    * Every other code point of the first string gets a byte from 128 up, through a
+      small open-addressing hash table.
+    * Code points of the second string that the first does not have all become
+      UTF8_UNKNOWN. The kernels only ever compare a character of one string with one
+      of the other, so it does not matter that those all look the same.
+
+    The byte kernels then see exactly the same matches as they would on code points,
+    including the match masks of the bit-parallel kernels. Only a first string with
+    more than 127 different non-ASCII code points does not fit; those pairs are
+    decoded to full code points and go to the banded kernel instead.
+
+    Invalid bytes are kept as code points of their own, so malformed strings still
+    get a distance rather than an error.
+
+    Released under the MIT license. See LICENSE.txt.
+*/
+
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+
+#include "osa.h"
+#include "osa_simd.h"
+
+// The byte for code points of the second string that the first does not have.
+constexpr unsigned char UTF8_UNKNOWN = 255;
+// Slots in the hash table, at least twice the 127 code points it can hold.
+constexpr size_t UTF8_ALPHABET_SLOTS = 256;
+
+// Code points are numbered from here; everything below is ASCII.
+constexpr unsigned UTF8_FIRST_ID = 128;
+
+/*
+    Decodes the code point at `p` and moves past it. A byte that does not start a
+    well-formed sequence is returned as 0x110000 plus its value, beyond every real
+    code point, and skipped on its own.
+*/
+inline char32_t utf8_next(const unsigned char *&p, const unsigned char *end) {
+    const unsigned char lead = *p++;
+    if (lead < 0x80) {
+        return lead;
+    }
+    size_t extra;
+    char32_t code_point;
+    char32_t least;
+    if (0xc0 == (lead & 0xe0)) {
+        extra = 1;
+        code_point = lead & 0x1f;
+        least = 0x80;
+    } else if (0xe0 == (lead & 0xf0)) {
+        extra = 2;
+        code_point = lead & 0x0f;
+        least = 0x800;
+    } else if (0xf0 == (lead & 0xf8)) {
+        extra = 3;
+        code_point = lead & 0x07;
+        least = 0x10000;
+    } else {
+        return 0x110000 + lead;
+    }
+    if ((size_t)(end - p) < extra) {
+        return 0x110000 + lead;
+    }
+    for (size_t i = 0; i < extra; ++i) {
+        if (0x80 != (p[i] & 0xc0)) {
+            return 0x110000 + lead;
+        }
+        code_point = (code_point << 6) | (p[i] & 0x3f);
+    }
+    // Overlong encodings, surrogates and values past U+10FFFF are not well-formed.
+    if (code_point < least || code_point > 0x10ffff ||
+        (code_point >= 0xd800 && code_point <= 0xdfff)) {
+        return 0x110000 + lead;
+    }
+    p += extra;
+    return code_point;
+}
+
+// Appends the UTF-8 encoding of `code_point` to `out`.
+inline void utf8_append(char32_t code_point, std::string &out) {
+    if (code_point < 0x80) {
+        out.push_back((char)code_point);
+    } else if (code_point < 0x800) {
+        out.push_back((char)(0xc0 | (code_point >> 6)));
+        out.push_back((char)(0x80 | (code_point & 0x3f)));
+    } else if (code_point < 0x10000) {
+        out.push_back((char)(0xe0 | (code_point >> 12)));
+        out.push_back((char)(0x80 | ((code_point >> 6) & 0x3f)));
+        out.push_back((char)(0x80 | (code_point & 0x3f)));
+    } else {
+        out.push_back((char)(0xf0 | (code_point >> 18)));
+        out.push_back((char)(0x80 | ((code_point >> 12) & 0x3f)));
+        out.push_back((char)(0x80 | ((code_point >> 6) & 0x3f)));
+        out.push_back((char)(0x80 | (code_point & 0x3f)));
+    }
+}
+
+// The number of code points in `s`.
+inline size_t utf8_length(std::string_view s) {
+    const unsigned char *p = (const unsigned char *)s.data();
+    const unsigned char *end = p + s.length();
+    size_t length = 0;
+    while (p < end) {
+        utf8_next(p, end);
+        ++length;
+    }
+    return length;
+}
+
+inline void utf8_decode(std::string_view s, std::u32string &out) {
+    out.clear();
+    const unsigned char *p = (const unsigned char *)s.data();
+    const unsigned char *end = p + s.length();
+    while (p < end) {
+        out.push_back(utf8_next(p, end));
+    }
+}
+
+// The bytes given to the non-ASCII code points of a string.
+struct Utf8Alphabet {
+    char32_t keys[UTF8_ALPHABET_SLOTS];
+    // 0 for an empty slot.
+    unsigned char ids[UTF8_ALPHABET_SLOTS];
+    unsigned next_id;
+};
+
+inline void utf8_alphabet_clear(Utf8Alphabet &alphabet) {
+    std::memset(alphabet.ids, 0, sizeof(alphabet.ids));
+    alphabet.next_id = UTF8_FIRST_ID;
+}
+
+inline size_t utf8_slot(char32_t code_point) {
+    return (size_t)((code_point * 0x9e3779b1u) >> 24) % UTF8_ALPHABET_SLOTS;
+}
+
+// Returns the byte for `code_point`, or UTF8_UNKNOWN if it has none.
+inline unsigned char utf8_find(const Utf8Alphabet &alphabet, char32_t code_point) {
+    for (size_t slot = utf8_slot(code_point);; slot = (slot + 1) % UTF8_ALPHABET_SLOTS) {
+        if (0 == alphabet.ids[slot]) {
+            return UTF8_UNKNOWN;
+        }
+        if (alphabet.keys[slot] == code_point) {
+            return alphabet.ids[slot];
+        }
+    }
+}
+
+/*
+    Rewrites `s` into `out` one byte per code point, numbering any code point it has
+    not seen before. Returns false if that would take more than the 127 bytes there
+    are, in which case `out` and the alphabet are left half done.
+*/
+inline bool utf8_compile(Utf8Alphabet &alphabet, std::string_view s, std::string &out) {
+    out.clear();
+    const unsigned char *p = (const unsigned char *)s.data();
+    const unsigned char *end = p + s.length();
+    while (p < end) {
+        const char32_t code_point = utf8_next(p, end);
+        if (code_point < 0x80) {
+            out.push_back((char)code_point);
+            continue;
+        }
+        size_t slot = utf8_slot(code_point);
+        while (0 != alphabet.ids[slot] && alphabet.keys[slot] != code_point) {
+            slot = (slot + 1) % UTF8_ALPHABET_SLOTS;
+        }
+        if (0 == alphabet.ids[slot]) {
+            if (UTF8_UNKNOWN == alphabet.next_id) {
+                return false;
+            }
+            alphabet.keys[slot] = code_point;
+            alphabet.ids[slot] = (unsigned char)alphabet.next_id++;
+        }
+        out.push_back((char)alphabet.ids[slot]);
+    }
+    return true;
+}
+
+// Rewrites `s` into `out` one byte per code point, without numbering new ones.
+inline void utf8_transcode(const Utf8Alphabet &alphabet, std::string_view s, std::string &out) {
+    out.clear();
+    const unsigned char *p = (const unsigned char *)s.data();
+    const unsigned char *end = p + s.length();
+    while (p < end) {
+        const char32_t code_point = utf8_next(p, end);
+        out.push_back(code_point < 0x80 ? (char)code_point
+                                        : (char)utf8_find(alphabet, code_point));
+    }
+}
+
+// Per-statement storage for the rewritten strings.
+struct Utf8Buffer {
+    Utf8Alphabet alphabet;
+    std::string a;
+    std::string b;
+    // For pairs that do not fit in bytes, and the rows of the banded kernel for them.
+    std::u32string wide_a;
+    std::u32string wide_b;
+    OsaBuffer wide_rows;
+};
+
+/*
+    Points `a` and `b` at one byte per code point versions of themselves, so that the
+    byte kernels compute the distance between their code points. Returns false if
+    they do not fit, in which case their code points are in `wide_a` and `wide_b`
+    instead.
+*/
+inline bool utf8_prepare(std::string_view &a, std::string_view &b, Utf8Buffer &buffer) {
+    const bool ascii_a = osa_is_ascii(a.data(), a.length());
+    const bool ascii_b = osa_is_ascii(b.data(), b.length());
+    if (ascii_a && ascii_b) {
+        return true;
+    }
+    // An ASCII string already is its own rewrite.
+    if (ascii_a) {
+        utf8_alphabet_clear(buffer.alphabet);
+        utf8_transcode(buffer.alphabet, b, buffer.b);
+        b = buffer.b;
+        return true;
+    }
+    utf8_alphabet_clear(buffer.alphabet);
+    if (!utf8_compile(buffer.alphabet, a, buffer.a)) {
+        utf8_decode(a, buffer.wide_a);
+        utf8_decode(b, buffer.wide_b);
+        return false;
+    }
+    a = buffer.a;
+    if (!ascii_b) {
+        utf8_transcode(buffer.alphabet, b, buffer.b);
+        b = buffer.b;
+    }
+    return true;
+}
+
+// The distance between two strings of code points with no limit, widening the band
+// until it proves the distance, as osa_doubling does for bytes.
+inline long long utf8_wide_distance(std::u32string_view a, std::u32string_view b,
+                                    OsaBuffer &buffer) {
+    const long long longer = (long long)std::max(a.length(), b.length());
+    long long k = std::max(16ll, longer - (long long)std::min(a.length(), b.length()));
+    while (true) {
+        k = std::min(k, longer);
+        const long long distance = osa_banded(a, b, k, buffer);
+        if (distance <= k) {
+            return distance;
+        }
+        k *= 2;
+    }
+}